@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+"""Writes an OpenAPI 3.0 spec with N multipart/form-data operations next to 500 component schemas.
+
+Every operation is turned into 20 formData parameters, each built from the request body schema
+and linked into the document, so this measures what it costs to link nodes between memories.
+
+    python3 bench/gen_form.py 400 form400.json
+    openapi-downgrader form400.json out.yaml --profile
+"""
+import json
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_form.py <operations> <output.json>")
+    n = int(sys.argv[1])
+    schemas = {f"S{i}": {"type": "object", "properties": {f"p{j}": {"type": "integer"} for j in range(30)}}
+               for i in range(500)}
+    paths = {}
+    for i in range(n):
+        fields = {f"f{j}": {"type": "string", "description": f"field {j} of op {i}"} for j in range(20)}
+        paths[f"/op{i}"] = {"post": {
+            "operationId": f"op{i}",
+            "requestBody": {"content": {"multipart/form-data": {"schema": {
+                "type": "object", "required": ["f0", "f3"], "properties": fields}}}},
+            "responses": {"200": {"description": "ok", "content": {"application/json": {
+                "schema": {"$ref": f"#/components/schemas/S{i % 500}"}}}}}}}
+    doc = {"openapi": "3.0.0", "info": {"title": "f", "version": "1"}, "paths": paths,
+           "components": {"schemas": schemas}}
+    with open(sys.argv[2], "w") as out:
+        json.dump(doc, out)
+
+
+if __name__ == "__main__":
+    main()
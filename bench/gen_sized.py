@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Writes an OpenAPI 3.0 JSON spec of about the given size in MB.
+
+Each item is a path with a GET and a POST and a component schema they $ref, with the escapes,
+numbers, nulls and nested arrays a generated spec carries. Items are written one at a time, so
+a few hundred MB take little memory to produce.
+
+    python3 bench/gen_sized.py 50 s50.json
+    openapi-downgrader s50.json out.yaml --profile
+
+With --yaml the file starts with a comment line. It is not JSON any more, and the same document
+goes through yaml-cpp instead of the JSON parser, for comparing the two loads.
+"""
+import json
+import sys
+
+
+def path_item(i):
+    return {
+        "parameters": [{"name": "id", "in": "path", "required": True, "schema": {"type": "integer"}}],
+        "get": {"operationId": f"get{i}",
+                "parameters": [{"name": "q", "in": "query", "style": "form", "explode": False,
+                                "schema": {"type": "array", "items": {"type": "string"}}}],
+                "responses": {"200": {"description": "ok", "content": {"application/json": {
+                    "schema": {"$ref": f"#/components/schemas/Item{i}"}, "example": {"id": 1}}}}}},
+        "post": {"requestBody": {"content": {"application/json": {
+                     "schema": {"$ref": f"#/components/schemas/Item{i}"}}}},
+                 "responses": {"201": {"description": "created", "headers": {
+                     "X-Rate": {"schema": {"type": "integer"}}}}}}}
+
+
+def schema(i):
+    return {
+        "type": "object", "description": f"Item \"{i}\" with unicode é ✓ and\nnewline",
+        "required": ["id"], "properties": {
+            "id": {"type": "integer", "format": "int64", "minimum": 0, "example": 1.5e3},
+            "name": {"type": "string", "nullable": True, "maxLength": 64, "default": "n/a"},
+            "tags": {"type": "array", "items": {"type": "string"}},
+            "secret": {"type": "string", "writeOnly": True},
+            "parent": {"$ref": f"#/components/schemas/Item{max(0, i - 1)}"},
+            "flag": {"type": "boolean", "default": False, "deprecated": True},
+            "nothing": None}}
+
+
+def entries(out, name, items):
+    out.write(f' "{name}": {{\n')
+    for n, (key, value) in enumerate(items):
+        out.write(("" if n == 0 else ",\n") + "  " + json.dumps(key) + ": " + json.dumps(value, ensure_ascii=False))
+    out.write("\n }")
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != "--yaml"]
+    if len(args) != 2:
+        sys.exit("usage: gen_sized.py <MB> <output.json> [--yaml]")
+    per_item = len(json.dumps({"/items0/{id}": path_item(0), "Item0": schema(0)}, ensure_ascii=False)) + 8
+    count = max(1, int(float(args[0]) * 1024 * 1024 / per_item))
+    with open(args[1], "w", encoding="utf-8") as out:
+        if "--yaml" in sys.argv:
+            out.write("# loaded by yaml-cpp\n")
+        out.write('{\n "openapi": "3.0.0",\n "info": {"title": "Sized", "version": "1.0"},\n')
+        entries(out, "paths", ((f"/items{i}/{{id}}", path_item(i)) for i in range(count)))
+        out.write(',\n "components": {\n')
+        entries(out, "schemas", ((f"Item{i}", schema(i)) for i in range(count)))
+        out.write("\n }\n}\n")
+
+
+if __name__ == "__main__":
+    main()
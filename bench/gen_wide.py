@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+"""Writes an OpenAPI 3.0 spec whose maps are N entries wide.
+
+One component schema has N properties and N paths each $ref one of them, so every path resolves a
+pointer into the same wide map. One more path carries an inline schema with the same N properties,
+half of them writeOnly, which the converter removes from the response schema.
+
+    python3 bench/gen_wide.py 8000 wide8000.json
+    openapi-downgrader wide8000.json out.yaml --profile
+"""
+import json
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_wide.py <width> <output.json>")
+    n = int(sys.argv[1])
+    props = {f"p{i}": ({"type": "string", "writeOnly": True} if i % 2 else {"type": "integer", "nullable": True})
+             for i in range(n)}
+    paths = {}
+    for i in range(n):
+        paths[f"/w{i}"] = {"get": {
+            "parameters": [{"name": "q", "in": "query", "schema": {
+                "$ref": f"#/components/schemas/Wide/properties/p{i}"}}],
+            "responses": {"200": {"description": "ok"}}}}
+    paths["/big"] = {"get": {"responses": {"200": {"description": "ok", "content": {"application/json": {
+        "schema": {"type": "object", "properties": props}}}}}}}
+    doc = {"openapi": "3.0.0", "info": {"title": "W", "version": "1"}, "paths": paths,
+           "components": {"schemas": {"Wide": {"type": "object", "properties": props}}}}
+    with open(sys.argv[2], "w") as out:
+        json.dump(doc, out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,83 @@
+// Bytes per node of a loaded spec, as a yaml-cpp node tree and as a compact::Document. Counts the
+// bytes requested from operator new that are still held once the document is loaded, without the
+// allocator's own overhead, and divides them by the number of nodes.
+//
+//   g++ -std=c++17 -O2 -Iinclude -Icode bench/node_bytes.cpp code/CompactDocument.cpp
+//       code/JsonParser.cpp code/MappedFile.cpp code/Util.cpp code/NodeView.cpp src/yaml-cpp/*.cpp
+//       -lyaml-cpp -pthread -o node_bytes
+//   ./node_bytes spec.json other.yaml ...
+
+#include "CompactDocument.h"
+#include "JsonParser.h"
+#include "yaml-cpp/yaml.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+
+namespace {
+
+    std::atomic<size_t> live_bytes{ 0 };
+    std::atomic<size_t> live_blocks{ 0 };
+    const size_t header = 16; // keeps the size, and the block aligned for any type
+
+    size_t CountNodes(const YAML::Node& node) {
+        size_t count = 1;
+        if (node.IsSequence()) {
+            for (const auto& item : node) count += CountNodes(item);
+        }
+        else if (node.IsMap()) {
+            for (const auto& entry : node) count += CountNodes(entry.first) + CountNodes(entry.second);
+        }
+        return count;
+    }
+}
+
+void* operator new(size_t size) {
+    void* p = std::malloc(size + header);
+    if (!p) throw std::bad_alloc();
+    *static_cast<size_t*>(p) = size;
+    live_bytes += size;
+    ++live_blocks;
+    return static_cast<char*>(p) + header;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    char* block = static_cast<char*>(p) - header;
+    live_bytes -= *reinterpret_cast<size_t*>(block);
+    --live_blocks;
+    std::free(block);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+int main(int argc, char* argv[]) {
+    std::printf("%-24s %10s %12s %12s %14s\n", "spec", "nodes", "tree B/node", "allocs/node", "compact B/node");
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        size_t bytes = live_bytes, blocks = live_blocks;
+        YAML::Node document = json::IsJson(data.data(), data.size()) ? json::Parse(data.data(), data.size()) : YAML::Load(data);
+        bytes = live_bytes - bytes;
+        blocks = live_blocks - blocks;
+        size_t nodes = CountNodes(document);
+        document = YAML::Node();
+
+        compact::Document compactDocument = compact::Load(data.data(), data.size());
+        std::printf("%-24s %10zu %12.1f %12.2f %14.1f\n", argv[i], nodes, double(bytes) / nodes, double(blocks) / nodes,
+            double(compactDocument.MemoryUsage()) / compactDocument.NodeCount());
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "Batch.h"
+#include "Cache.h"
+#include "Converter.h"
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace batch {
+
+    // Peak memory per byte of input. As yaml-cpp nodes, each with its own strings and vectors,
+    // a loaded spec takes 30 to 100 times its file size. A compact document holds only the spec outside paths
+    // and one path item as nodes, 5 to 35 times.
+    const size_t memory_per_input_byte = 104;
+    const size_t compact_memory_per_input_byte = 40;
+
+    struct Job {
+        std::string input;
+        std::string output;
+        size_t size = 0;
+        size_t memory = 0;
+        OutputFormat format = OutputFormat::Yaml;
+        bool started = false;
+        bool success = false;
+        bool cached = false;
+        bool unchanged = false;
+        std::string error;
+        double milliseconds = 0;
+    };
+
+    size_t GetPhysicalMemory() {
+#ifdef _WIN32
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        if (GlobalMemoryStatusEx(&status)) {
+            return static_cast<size_t>(status.ullTotalPhys);
+        }
+        return 0;
+#else
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGE_SIZE);
+        if (pages <= 0 || pageSize <= 0) return 0;
+        return static_cast<size_t>(pages) * static_cast<size_t>(pageSize);
+#endif
+    }
+
+    std::string Extension(const fs::path& path) {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+
+    bool IsSpecFile(const fs::path& path) {
+        std::string ext = Extension(path);
+        return ext == ".yaml" || ext == ".yml" || ext == ".json";
+    }
+
+    OutputFormat FormatFor(const std::string& output, const std::string& outputFormat) {
+        if (outputFormat == "json") return OutputFormat::Json;
+        if (outputFormat == "auto" && Extension(output) == ".json") return OutputFormat::Json;
+        return OutputFormat::Yaml;
+    }
+
+    // With JSON output the mirrored files are renamed to .json
+    std::vector<Job> CollectDirectory(const fs::path& dir, const fs::path& outputDir, bool jsonOutput) {
+        std::vector<Job> jobs;
+        for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+            if (!entry.is_regular_file() || !IsSpecFile(entry.path())) continue;
+            Job job;
+            job.input = entry.path().string();
+            fs::path output = outputDir / fs::relative(entry.path(), dir);
+            if (jsonOutput) output.replace_extension(".json");
+            job.output = output.string();
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    // One spec per line: "input [output]". Without an explicit output the file goes to outputDir.
+    std::vector<Job> ReadManifest(const fs::path& manifest, const fs::path& outputDir) {
+        std::vector<Job> jobs;
+        std::ifstream in(manifest);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open manifest: " + manifest.string());
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line[start] == '#') continue;
+            size_t end = line.find_first_of(" \t", start);
+
+            Job job;
+            job.input = line.substr(start, end - start);
+            size_t outStart = end == std::string::npos ? std::string::npos : line.find_first_not_of(" \t", end);
+            if (outStart != std::string::npos) {
+                size_t outEnd = line.find_last_not_of(" \t");
+                job.output = line.substr(outStart, outEnd - outStart + 1);
+            }
+            else if (!outputDir.empty()) {
+                job.output = (outputDir / fs::path(job.input).filename()).string();
+            }
+            else {
+                throw std::runtime_error("No output for " + job.input + " in manifest and no output directory given");
+            }
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    // Hands out the largest pending spec that still fits into the memory budget.
+    // A spec larger than the whole budget runs alone.
+    class Scheduler {
+    public:
+        Scheduler(std::vector<Job>& jobs, size_t budget) : jobs(jobs), budget(budget) {}
+
+        Job* Next() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                while (first < jobs.size() && jobs[first].started) ++first;
+                if (first == jobs.size()) return nullptr;
+
+                for (size_t i = first; i < jobs.size(); ++i) {
+                    Job& job = jobs[i];
+                    if (job.started) continue;
+                    if (inFlight == 0 || inFlight + job.memory <= budget) {
+                        job.started = true;
+                        inFlight += job.memory;
+                        return &job;
+                    }
+                }
+                ready.wait(lock);
+            }
+        }
+
+        void Finish(const Job* job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight -= job->memory;
+            }
+            ready.notify_all();
+        }
+
+    private:
+        std::vector<Job>& jobs;
+        size_t budget;
+        size_t inFlight = 0;
+        size_t first = 0;
+        std::mutex mutex;
+        std::condition_variable ready;
+    };
+
+    void Convert(Converter& converter, Cache* cache, Job& job) {
+        auto start = std::chrono::steady_clock::now();
+        converter.SetOutputFormat(job.format);
+        try {
+            fs::path outPath(job.output);
+            if (outPath.has_parent_path()) {
+                fs::create_directories(outPath.parent_path());
+            }
+            OutputFile outFile(job.output);
+            if (!outFile.IsOpen()) {
+                throw std::runtime_error("Failed to open output file: " + job.output);
+            }
+            if (cache) {
+                job.cached = cache->Convert(converter, job.input, outFile.Stream());
+            }
+            else {
+                converter.Convert(job.input, outFile.Stream());
+            }
+            if (!outFile.Commit()) {
+                throw std::runtime_error("Failed to write output file: " + job.output);
+            }
+            job.unchanged = outFile.Unchanged();
+            job.success = true;
+        }
+        catch (const std::exception& err) {
+            job.error = err.what();
+        }
+        job.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    int Run(const std::string& target, const Options& options) {
+        std::vector<Job> jobs;
+        try {
+            if (fs::is_directory(target)) {
+                if (options.outputDir.empty()) {
+                    std::cerr << "An output directory is required when converting a directory" << std::endl;
+                    return 1;
+                }
+                jobs = CollectDirectory(target, options.outputDir, options.outputFormat == "json");
+            }
+            else {
+                jobs = ReadManifest(target, options.outputDir);
+            }
+        }
+        catch (const std::exception& err) {
+            std::cerr << err.what() << std::endl;
+            return 1;
+        }
+
+        if (jobs.empty()) {
+            std::cerr << "No specs found in " << target << std::endl;
+            return 1;
+        }
+
+        for (auto& job : jobs) {
+            job.format = FormatFor(job.output, options.outputFormat);
+            std::error_code ec;
+            auto size = fs::file_size(job.input, ec);
+            job.size = ec ? 0 : static_cast<size_t>(size);
+            job.memory = job.size * (options.compact || options.streaming ? compact_memory_per_input_byte : memory_per_input_byte);
+        }
+        std::stable_sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.size > b.size; });
+
+        size_t budget = options.maxMemory;
+        if (budget == 0) {
+            budget = GetPhysicalMemory() / 2;
+        }
+        if (budget == 0) {
+            budget = SIZE_MAX;
+        }
+
+        std::unique_ptr<Cache> cache;
+        if (!options.cache.empty()) {
+            try {
+                cache = Cache::Open(options.cache);
+            }
+            catch (const std::exception& err) {
+                std::cerr << "Failed to open cache " << options.cache << ": " << err.what() << std::endl;
+                return 1;
+            }
+        }
+
+        unsigned workerCount = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+        workerCount = std::max(1u, std::min(workerCount, static_cast<unsigned>(jobs.size())));
+
+        auto start = std::chrono::steady_clock::now();
+        Scheduler scheduler(jobs, budget);
+        std::vector<std::thread> workers;
+        ConverterOptions converterOptions;
+        converterOptions.compact = options.compact;
+        converterOptions.streaming = options.streaming;
+        for (unsigned i = 0; i < workerCount; ++i) {
+            workers.emplace_back([&scheduler, &cache, &converterOptions]() {
+                Converter converter(converterOptions);
+                while (Job* job = scheduler.Next()) {
+                    Convert(converter, cache.get(), *job);
+                    scheduler.Finish(job);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.input < b.input; });
+        size_t failed = 0;
+        for (const auto& job : jobs) {
+            if (job.success) {
+                std::cout << "OK      " << job.input << " -> " << job.output << " (" << static_cast<long long>(job.milliseconds) << " ms"
+                    << (job.cached ? ", cached" : "") << (job.unchanged ? ", unchanged" : "") << ")\n";
+            }
+            else {
+                ++failed;
+                std::cout << "FAILED  " << job.input << ": " << job.error << "\n";
+            }
+        }
+        std::cout << "\n" << jobs.size() - failed << " converted, " << failed << " failed in " << total << " s using " << workerCount << " threads" << std::endl;
+        if (cache) {
+            std::cout << "cache: " << cache->Hits() << " hits, " << cache->Misses() << " misses" << std::endl;
+        }
+
+        return failed == 0 ? 0 : 1;
+    }
+}
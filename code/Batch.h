@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+namespace batch {
+
+    struct Options {
+        std::string outputDir;
+        std::string cache;
+        std::string outputFormat = "yaml"; // yaml, json, or auto to follow each output file's extension
+        unsigned jobs = 0;
+        size_t maxMemory = 0;
+        bool compact = false; // convert with --compact
+        bool streaming = false; // convert with --stream
+    };
+
+    int Run(const std::string& target, const Options& options);
+}
@@ -0,0 +1,335 @@
+#include "Cache.h"
+#include "MappedFile.h"
+#include "Sha256.h"
+#include "Version.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    // Everything besides the input that changes the output has to be part of the key: the format,
+    // how the document is held (--compact and --stream number anchors per path item), whether path
+    // items are converted in parallel (anchors shared between them become copies) and the depth
+    // limit, which decides whether a spec converts at all. Only mapInput leaves the output alone.
+    std::string OptionsTag(const ConverterOptions& options) {
+        std::string tag = options.format == OutputFormat::Json ? "format=json" : "format=yaml";
+        tag += options.streaming ? " mode=stream" : options.compact ? " mode=compact" : " mode=tree";
+        tag += options.threads == 1 ? " threads=1" : " threads=n";
+        tag += " depth=" + std::to_string(options.maxDepth);
+        return tag;
+    }
+
+    // Hands everything written to both the output and a new cache entry. A failing entry is
+    // dropped and the output carries on, a failing output fails the stream.
+    class TeeBuffer : public std::streambuf {
+    public:
+        TeeBuffer(std::streambuf* out, std::streambuf* entry) : out(out), entry(entry), buffer(1 << 16) {
+            setp(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        bool EntryFailed() const { return entryFailed; }
+
+    protected:
+        int_type overflow(int_type c) override {
+            if (!Flush()) return traits_type::eof();
+            if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+            return c;
+        }
+
+        int sync() override {
+            return Flush() && out->pubsync() == 0 ? 0 : -1;
+        }
+
+    private:
+        bool Flush() {
+            std::streamsize n = pptr() - pbase();
+            setp(buffer.data(), buffer.data() + buffer.size());
+            if (n == 0) return true;
+            if (!entryFailed && entry->sputn(buffer.data(), n) != n) entryFailed = true;
+            return out->sputn(buffer.data(), n) == n;
+        }
+
+        std::streambuf* out;
+        std::streambuf* entry;
+        std::vector<char> buffer;
+        bool entryFailed = false;
+    };
+
+    std::string Key(const char* data, size_t size, const ConverterOptions& options) {
+        Sha256 hash;
+        hash.Update(std::string(OPENAPI_DOWNGRADER_VERSION) + "\n" + OptionsTag(options) + "\n");
+        hash.Update(data, size);
+        return hash.HexDigest();
+    }
+
+    // Entries are sharded by the first two hex digits. Writes go through a temp file and a
+    // rename, so several processes can share one directory.
+    class DirectoryBackend : public CacheBackend {
+    public:
+        explicit DirectoryBackend(const fs::path& root) : root(root) {}
+
+        bool Get(const std::string& key, std::string& data) override {
+            std::ifstream in(PathFor(key), std::ios::binary);
+            if (!in.is_open()) return false;
+            data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            return !in.bad();
+        }
+
+        void Put(const std::string& key, const std::string& data) override {
+            std::unique_ptr<OutputFile> out = Create(key);
+            if (!out) return;
+            out->Stream() << data;
+            out->Commit();
+        }
+
+        std::unique_ptr<OutputFile> Create(const std::string& key) override {
+            fs::path path = PathFor(key);
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+            auto out = std::make_unique<OutputFile>(path.string());
+            if (!out->IsOpen()) return nullptr;
+            return out;
+        }
+
+    private:
+        fs::path PathFor(const std::string& key) const {
+            return root / key.substr(0, 2) / key;
+        }
+
+        fs::path root;
+    };
+
+#ifndef _WIN32
+
+    // Plain HTTP/1.1: GET <prefix>/<key> returns the entry, PUT <prefix>/<key> stores it.
+    class HttpBackend : public CacheBackend {
+    public:
+        explicit HttpBackend(const std::string& url) {
+            std::string rest = url.substr(std::string("http://").size());
+            size_t slash = rest.find('/');
+            std::string authority = rest.substr(0, slash);
+            prefix = slash == std::string::npos ? "" : rest.substr(slash);
+            while (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+
+            size_t colon = authority.rfind(':');
+            host = authority.substr(0, colon);
+            port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+            if (host.empty()) {
+                throw std::runtime_error("Invalid cache URL: " + url);
+            }
+        }
+
+        bool Get(const std::string& key, std::string& data) override {
+            std::string response;
+            if (!Request("GET", key, nullptr, response)) return false;
+            return ParseResponse(response, data) == 200;
+        }
+
+        void Put(const std::string& key, const std::string& data) override {
+            std::string response;
+            Request("PUT", key, &data, response);
+        }
+
+    private:
+        // A cache that does not answer in time is a miss, or a lost entry for Put, and the
+        // conversion goes ahead without it
+        static constexpr int ConnectTimeoutMs = 2000;
+        static constexpr int IoTimeoutSeconds = 5;
+
+        int Connect() const {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* addresses = nullptr;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) return -1;
+
+            int fd = -1;
+            for (addrinfo* ai = addresses; ai; ai = ai->ai_next) {
+                fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                if (fd < 0) continue;
+                if (ConnectWithin(fd, ai->ai_addr, ai->ai_addrlen)) break;
+                close(fd);
+                fd = -1;
+            }
+            freeaddrinfo(addresses);
+            if (fd < 0) return -1;
+
+            timeval timeout{ IoTimeoutSeconds, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            return fd;
+        }
+
+        // Connects without blocking and waits for the handshake at most ConnectTimeoutMs, then
+        // puts the socket back into blocking mode
+        static bool ConnectWithin(int fd, const sockaddr* address, socklen_t length) {
+            int flags = fcntl(fd, F_GETFL, 0);
+            if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) return false;
+            if (connect(fd, address, length) != 0) {
+                if (errno != EINPROGRESS) return false;
+                pollfd pfd{ fd, POLLOUT, 0 };
+                int n;
+                do {
+                    n = poll(&pfd, 1, ConnectTimeoutMs);
+                } while (n < 0 && errno == EINTR);
+                int error = 0;
+                socklen_t size = sizeof(error);
+                if (n <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0 || error != 0) return false;
+            }
+            return fcntl(fd, F_SETFL, flags) == 0;
+        }
+
+        bool Request(const std::string& method, const std::string& key, const std::string* body, std::string& response) const {
+            if (unavailable) return false;
+            int fd = Connect();
+            if (fd < 0) {
+                unavailable = true;
+                return false;
+            }
+
+            std::ostringstream request;
+            request << method << " " << prefix << "/" << key << " HTTP/1.1\r\n";
+            request << "Host: " << host << "\r\n";
+            request << "Connection: close\r\n";
+            if (body) {
+                request << "Content-Type: application/octet-stream\r\n";
+                request << "Content-Length: " << body->size() << "\r\n";
+            }
+            request << "\r\n";
+            std::string head = request.str();
+
+            bool ok = SendAll(fd, head.data(), head.size()) && (!body || SendAll(fd, body->data(), body->size()));
+            if (ok) {
+                char buffer[1 << 16];
+                ssize_t n;
+                // a timeout ends the loop with n < 0, the response is incomplete and not used
+                while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0 || (n < 0 && errno == EINTR)) {
+                    if (n > 0) response.append(buffer, static_cast<size_t>(n));
+                }
+                ok = n == 0;
+            }
+            if (!ok && (errno == EAGAIN || errno == EWOULDBLOCK)) unavailable = true;
+            close(fd);
+            return ok;
+        }
+
+        static bool SendAll(int fd, const char* data, size_t size) {
+            while (size > 0) {
+                ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                data += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        // Returns the status code and the body of a Connection: close response
+        static int ParseResponse(const std::string& response, std::string& body) {
+            size_t headerEnd = response.find("\r\n\r\n");
+            size_t space = response.find(' ');
+            if (headerEnd == std::string::npos || space == std::string::npos) return 0;
+            int status = std::atoi(response.c_str() + space + 1);
+
+            body = response.substr(headerEnd + 4);
+            std::string headers = response.substr(0, headerEnd);
+            for (auto& c : headers) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (headers.find("\r\ntransfer-encoding: chunked") != std::string::npos) return 0;
+            size_t length = headers.find("\r\ncontent-length:");
+            if (length != std::string::npos) {
+                size_t expected = std::strtoull(headers.c_str() + length + 17, nullptr, 10);
+                if (body.size() != expected) return 0;
+            }
+            return status;
+        }
+
+        std::string host;
+        std::string port;
+        std::string prefix;
+        // set once the server could not be reached or timed out, every later lookup is a miss
+        // instead of another wait
+        mutable std::atomic<bool> unavailable{ false };
+    };
+
+#endif
+}
+
+std::unique_ptr<Cache> Cache::Open(const std::string& location) {
+    if (location.rfind("http://", 0) == 0) {
+#ifdef _WIN32
+        throw std::runtime_error("HTTP cache is only supported on POSIX systems");
+#else
+        return std::make_unique<Cache>(std::make_unique<HttpBackend>(location));
+#endif
+    }
+    fs::create_directories(location);
+    return std::make_unique<Cache>(std::make_unique<DirectoryBackend>(location));
+}
+
+bool Cache::Convert(Converter& converter, const char* data, size_t size, std::ostream& out) {
+    std::string key = Key(data, size, converter.GetOptions());
+    std::string result;
+    if (backend->Get(key, result)) {
+        ++hits;
+        out.write(result.data(), static_cast<std::streamsize>(result.size()));
+        return true;
+    }
+    ++misses;
+
+    // The output goes to the caller and into a temporary cache file as it is written, and the
+    // entry appears under its key only once the conversion has succeeded
+    if (std::unique_ptr<OutputFile> entry = backend->Create(key)) {
+        TeeBuffer tee(out.rdbuf(), entry->Stream().rdbuf());
+        std::ostream both(&tee);
+        converter.Convert(data, size, both);
+        both.flush();
+        if (!both) {
+            out.setstate(std::ios::badbit);
+            return false;
+        }
+        if (!tee.EntryFailed()) entry->Commit();
+        return false;
+    }
+    result = converter.Convert(data, size);
+    backend->Put(key, result);
+    out.write(result.data(), static_cast<std::streamsize>(result.size()));
+    return false;
+}
+
+bool Cache::Convert(Converter& converter, const std::string& source, std::ostream& out) {
+    MappedFile file;
+    if (converter.GetOptions().mapInput && file.Open(source)) {
+        return Convert(converter, file.Data(), file.Size(), out);
+    }
+    std::ifstream in(source, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open input file: " + source);
+    }
+    return Convert(converter, in, out);
+}
+
+bool Cache::Convert(Converter& converter, std::istream& source, std::ostream& out) {
+    std::string data((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+    return Convert(converter, data.data(), data.size(), out);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "Converter.h"
+#include "OutputFile.h"
+
+class CacheBackend {
+public:
+    virtual ~CacheBackend() = default;
+    virtual bool Get(const std::string& key, std::string& data) = 0;
+    virtual void Put(const std::string& key, const std::string& data) = 0;
+    // An entry written as the output is produced and stored by its Commit(), nullptr when the
+    // backend can only store a complete result with Put
+    virtual std::unique_ptr<OutputFile> Create(const std::string& key) { (void)key; return nullptr; }
+};
+
+// Conversion results keyed by a hash of the input bytes, the tool version and the options.
+// A hit writes the stored output without parsing the input.
+class Cache {
+public:
+    explicit Cache(std::unique_ptr<CacheBackend> backend) : backend(std::move(backend)) {}
+
+    // location is a local or shared directory, or an http:// URL
+    static std::unique_ptr<Cache> Open(const std::string& location);
+
+    // Return true when the output came from the cache
+    bool Convert(Converter& converter, const std::string& source, std::ostream& out);
+    bool Convert(Converter& converter, std::istream& source, std::ostream& out);
+    bool Convert(Converter& converter, const char* data, size_t size, std::ostream& out);
+
+    uint64_t Hits() const { return hits; }
+    uint64_t Misses() const { return misses; }
+
+private:
+    std::unique_ptr<CacheBackend> backend;
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+};
@@ -0,0 +1,171 @@
+#include "Server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+#ifdef _WIN32
+
+    int RunClient(const ClientOptions& options) {
+        std::cerr << "client is only supported on POSIX systems" << std::endl;
+        return 1;
+    }
+
+#else
+
+    bool SendWithFd(int fd, const Header& header, int passedFd) {
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        iovec iov{ const_cast<Header*>(&header), sizeof(header) };
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &passedFd, sizeof(int));
+        return sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(header));
+    }
+
+    bool ReadResponse(int fd, Header& header, std::string& body) {
+        if (!ReadFully(fd, &header, sizeof(header))) return false;
+        body.resize(header.length);
+        return ReadFully(fd, &body[0], body.size());
+    }
+
+    int Connect(const std::string& path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return -1;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int CreateMemfd(const std::string& data) {
+#ifdef __linux__
+        int fd = memfd_create("openapi-spec", 0);
+        if (fd < 0) return -1;
+        size_t offset = 0;
+        while (offset < data.size()) {
+            ssize_t n = write(fd, data.data() + offset, data.size() - offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fd);
+                return -1;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        return fd;
+#else
+        return -1;
+#endif
+    }
+
+    int RunClient(const ClientOptions& options) {
+        int fd = Connect(options.socket);
+        if (fd < 0) {
+            std::cerr << "Failed to connect to " << options.socket << std::endl;
+            return 1;
+        }
+
+        Header header;
+        std::string body;
+        if (options.stats) {
+            Header request{ OpStats, 0 };
+            if (!WriteFully(fd, &request, sizeof(request)) || !ReadResponse(fd, header, body)) {
+                std::cerr << "Connection lost" << std::endl;
+                close(fd);
+                return 1;
+            }
+            std::cout << body;
+            close(fd);
+            return 0;
+        }
+
+        std::ifstream inFile(options.input, std::ios::binary);
+        if (!inFile.is_open()) {
+            std::cerr << "Failed to open input file: " << options.input << std::endl;
+            close(fd);
+            return 1;
+        }
+        std::string spec((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+        int memfd = -1;
+        if (options.memfd) {
+            memfd = CreateMemfd(spec);
+            if (memfd < 0) {
+                std::cerr << "memfd is not available" << std::endl;
+                close(fd);
+                return 1;
+            }
+        }
+
+        std::vector<double> latencies;
+        for (unsigned i = 0; i < options.repeat; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            bool sent;
+            if (memfd >= 0) {
+                sent = SendWithFd(fd, Header{ OpConvertFd, spec.size() }, memfd);
+            }
+            else {
+                Header request{ OpConvert, spec.size() };
+                sent = WriteFully(fd, &request, sizeof(request)) && WriteFully(fd, spec.data(), spec.size());
+            }
+            if (!sent || !ReadResponse(fd, header, body)) {
+                std::cerr << "Connection lost" << std::endl;
+                close(fd);
+                return 1;
+            }
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            if (header.code != StatusOk) {
+                std::cerr << "Conversion failed: " << body << std::endl;
+                close(fd);
+                return 1;
+            }
+        }
+        if (memfd >= 0) close(memfd);
+        close(fd);
+
+        if (!options.output.empty()) {
+            std::ofstream outFile(options.output, std::ios::binary);
+            if (!outFile.is_open()) {
+                std::cerr << "Failed to open output file: " << options.output << std::endl;
+                return 1;
+            }
+            outFile << body;
+        }
+
+        if (options.repeat > 1) {
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&latencies](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1) + 0.5)]; };
+            std::cout << options.repeat << " requests, p50 " << percentile(0.50) << " ms, p90 " << percentile(0.90)
+                << " ms, p99 " << percentile(0.99) << " ms, max " << latencies.back() << " ms" << std::endl;
+        }
+        return 0;
+    }
+
+#endif
+}
@@ -0,0 +1,275 @@
+#include "CompactDocument.h"
+#include "JsonParser.h"
+#include "MappedFile.h"
+#include "Util.h"
+
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+
+namespace compact {
+
+    YAML::EmitterStyle::value Document::Style(Index node) const {
+        return static_cast<YAML::EmitterStyle::value>(nodes[node].style & ~(aliased_bit | borrowed_bit | alias_bit));
+    }
+
+    std::string_view Document::Scalar(Index node) const {
+        const Node& n = nodes[node];
+        if (n.kind != static_cast<uint8_t>(Kind::Scalar)) return std::string_view();
+        const char* base = (n.style & borrowed_bit) ? source : strings.data();
+        return std::string_view(base + n.begin, n.size);
+    }
+
+    Index Document::Find(Index map, std::string_view key) const {
+        if (GetKind(map) != Kind::Map) return npos;
+        for (size_t i = 0; i < Size(map); ++i) {
+            Index k = Key(map, i);
+            if (GetKind(k) == Kind::Scalar && Scalar(k) == key) return Value(map, i);
+        }
+        return npos;
+    }
+
+    Index Document::Navigate(const std::vector<std::string>& keys) const {
+        if (Empty()) return npos;
+        Index cur = Root();
+        for (const auto& key : keys) {
+            if (GetKind(cur) == Kind::Sequence && !key.empty() && key.find_first_not_of("0123456789") == std::string::npos) {
+                size_t i = std::stoul(key);
+                if (i >= Size(cur)) return npos;
+                cur = Item(cur, i);
+            }
+            else {
+                cur = Find(cur, key);
+                if (cur == npos) return npos;
+            }
+        }
+        return cur;
+    }
+
+    // An aliased node is created once and handed out again for every alias. fill is set for a
+    // container that was just created and still has to get its children. The node is made in the
+    // memory of owner, the root of the tree being built, once there is one.
+    YAML::Node Document::Create(Index node, const YAML::Node& owner, std::unordered_map<Index, YAML::Node>& shared, bool& fill) const {
+        const Node& n = nodes[node];
+        fill = false;
+        bool aliased = (n.style & aliased_bit) != 0;
+        if (aliased) {
+            auto found = shared.find(node);
+            if (found != shared.end()) return found->second;
+        }
+        YAML::Node result;
+        switch (static_cast<Kind>(n.kind)) {
+        case Kind::Null:
+            result = util::NewNode(owner, YAML::NodeType::Null);
+            break;
+        case Kind::Scalar:
+            result = util::NewNode(owner, std::string(Scalar(node)));
+            break;
+        case Kind::Sequence:
+            result = util::NewNode(owner, YAML::NodeType::Sequence);
+            result.SetStyle(Style(node));
+            fill = true;
+            break;
+        case Kind::Map:
+            result = util::NewNode(owner, YAML::NodeType::Map);
+            result.SetStyle(Style(node));
+            fill = true;
+            break;
+        }
+        if (!tags[n.tag].empty()) result.SetTag(tags[n.tag]);
+        if (aliased) shared.emplace(node, result);
+        return result;
+    }
+
+    // With a work stack rather than recursion, like the schema walk of the converter. Containers
+    // are attached to their parent before they are filled, as the JSON parser does.
+    YAML::Node Document::ToNode(Index node, Index skip) const {
+        std::unordered_map<Index, YAML::Node> shared;
+        bool fill;
+        YAML::Node root = Create(node, YAML::Node(), shared, fill);
+        std::vector<std::pair<Index, YAML::Node>> stack;
+        if (fill) stack.emplace_back(node, root);
+        while (!stack.empty()) {
+            Index index = stack.back().first;
+            YAML::Node target = stack.back().second;
+            stack.pop_back();
+            if (GetKind(index) == Kind::Sequence) {
+                for (size_t i = 0; i < Size(index); ++i) {
+                    Index item = Item(index, i);
+                    YAML::Node child = Create(item, root, shared, fill);
+                    target.push_back(child);
+                    if (fill) stack.emplace_back(item, child);
+                }
+            }
+            else {
+                for (size_t i = 0; i < Size(index); ++i) {
+                    Index value = Value(index, i);
+                    if (value == skip) continue;
+                    Index key = Key(index, i);
+                    YAML::Node keyNode = GetKind(key) == Kind::Scalar || GetKind(key) == Kind::Null ? Create(key, root, shared, fill) : ToNode(key);
+                    YAML::Node child = Create(value, root, shared, fill);
+                    target.force_insert(keyNode, child);
+                    if (fill) stack.emplace_back(value, child);
+                }
+            }
+        }
+        return root;
+    }
+
+    size_t Document::MemoryUsage() const {
+        size_t tagBytes = 0;
+        for (const auto& tag : tags) tagBytes += sizeof(tag) + tag.capacity();
+        return sizeof(*this) + nodes.capacity() * sizeof(Node) + strings.capacity() + tagBytes;
+    }
+
+    Builder::Builder(Document& document, const char* source, size_t size) : document(document), size(source ? size : 0) {
+        // the tags nearly every node has: none, plain and quoted
+        if (document.tags.empty()) document.tags = { "", "?", "!" };
+        if (source) document.source = source;
+    }
+
+    void Builder::OnDocumentStart(const YAML::Mark&) {}
+
+    // The root is placed last, then the aliases can all be pointed at their nodes
+    void Builder::OnDocumentEnd() {
+        for (const Pending& node : pending) Place(node);
+        pending.clear();
+        if (!document.nodes.empty()) document.root = static_cast<Index>(document.nodes.size() - 1);
+        for (const auto& alias : aliases) {
+            Index node = anchors[alias.second];
+            document.nodes[alias.first].begin = node;
+            document.nodes[node].style |= Document::aliased_bit;
+        }
+        aliases.clear();
+        document.nodes.shrink_to_fit();
+        document.strings.shrink_to_fit();
+    }
+
+    void Builder::OnNull(const YAML::Mark&, YAML::anchor_t anchor) {
+        pending.push_back(Make(Kind::Null, "", anchor, YAML::EmitterStyle::Default));
+    }
+
+    void Builder::OnAlias(const YAML::Mark&, YAML::anchor_t anchor) {
+        if (anchors.find(anchor) == anchors.end()) {
+            throw YAML::ParserException(YAML::Mark::null_mark(), "unknown anchor");
+        }
+        Pending alias = Make(Kind::Null, "", YAML::NullAnchor, YAML::EmitterStyle::Default);
+        alias.node.style |= Document::alias_bit;
+        alias.anchor = anchor;
+        pending.push_back(alias);
+    }
+
+    void Builder::OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) {
+        Pending scalar = Make(Kind::Scalar, tag, anchor, YAML::EmitterStyle::Default);
+        if (!Borrow(scalar.node, mark, value)) {
+            if (document.strings.size() + value.size() >= npos) {
+                throw std::length_error("Document is too large for the compact model");
+            }
+            scalar.node.begin = static_cast<uint32_t>(document.strings.size());
+            scalar.node.size = static_cast<uint32_t>(value.size());
+            document.strings += value;
+        }
+        pending.push_back(scalar);
+    }
+
+    void Builder::OnSequenceStart(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) {
+        Open(Make(Kind::Sequence, tag, anchor, style));
+    }
+
+    void Builder::OnSequenceEnd() {
+        Close();
+    }
+
+    void Builder::OnMapStart(const YAML::Mark&, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) {
+        Open(Make(Kind::Map, tag, anchor, style));
+    }
+
+    void Builder::OnMapEnd() {
+        Close();
+    }
+
+    Builder::Pending Builder::Make(Kind kind, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) {
+        if (anchor != YAML::NullAnchor) {
+            anchors[anchor] = npos;
+        }
+        return Pending{ { static_cast<uint8_t>(kind), static_cast<uint8_t>(style), TagId(tag), 0, 0 }, anchor };
+    }
+
+    void Builder::Open(const Pending& node) {
+        pending.push_back(node);
+        starts.push_back(pending.size());
+    }
+
+    // The children of a container are only known once it ends, they are then moved into one range
+    void Builder::Close() {
+        size_t start = starts.back();
+        starts.pop_back();
+        size_t count = pending.size() - start;
+        Document::Node& n = pending[start - 1].node;
+        n.begin = static_cast<uint32_t>(document.nodes.size());
+        n.size = static_cast<uint32_t>(n.kind == static_cast<uint8_t>(Kind::Map) ? count / 2 : count);
+        for (size_t i = start; i < pending.size(); ++i) Place(pending[i]);
+        pending.resize(start);
+    }
+
+    void Builder::Place(const Pending& node) {
+        if (document.nodes.size() >= npos - 1) {
+            throw std::length_error("Document is too large for the compact model");
+        }
+        Index index = static_cast<Index>(document.nodes.size());
+        document.nodes.push_back(node.node);
+        if (node.node.style & Document::alias_bit) aliases.emplace_back(index, node.anchor);
+        else if (node.anchor != YAML::NullAnchor) anchors[node.anchor] = index;
+    }
+
+    // The mark of a scalar is where it starts, at its first byte or at the opening quote. Whatever
+    // the parser made of the text, bytes that match the value are the value.
+    bool Builder::Borrow(Document::Node& node, const YAML::Mark& mark, const std::string& value) {
+        if (mark.pos < 0 || value.empty()) return false;
+        for (size_t at : { static_cast<size_t>(mark.pos), static_cast<size_t>(mark.pos) + 1 }) {
+            if (at + value.size() > size || at + value.size() >= npos) return false;
+            if (std::memcmp(document.source + at, value.data(), value.size()) == 0) {
+                node.style |= Document::borrowed_bit;
+                node.begin = static_cast<uint32_t>(at);
+                node.size = static_cast<uint32_t>(value.size());
+                ++document.borrowed;
+                document.borrowedBytes += value.size();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint16_t Builder::TagId(const std::string& tag) {
+        auto& tags = document.tags;
+        for (size_t i = 0; i < tags.size(); ++i) {
+            if (tags[i] == tag) return static_cast<uint16_t>(i);
+        }
+        if (tags.size() > UINT16_MAX) {
+            throw std::length_error("Document has too many distinct tags for the compact model");
+        }
+        tags.push_back(tag);
+        return static_cast<uint16_t>(tags.size() - 1);
+    }
+
+    Document Load(const char* data, size_t size) {
+        Document document;
+        if (json::IsJson(data, size)) {
+            try {
+                Builder builder(document, data, size);
+                json::Parse(data, size, builder);
+                return document;
+            }
+            catch (const json::NotStrictJson&) {
+                // not strict JSON, e.g. a YAML flow mapping with plain keys
+                document = Document();
+            }
+        }
+        MemoryStreamBuf buffer(data, size);
+        std::istream stream(&buffer);
+        YAML::Parser parser(stream);
+        Builder builder(document, data, size);
+        parser.HandleNextDocument(builder);
+        return document;
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "yaml-cpp/eventhandler.h"
+#include "yaml-cpp/yaml.h"
+
+namespace compact {
+
+    using Index = uint32_t;
+    const Index npos = static_cast<Index>(-1);
+
+    enum class Kind : uint8_t { Null, Scalar, Sequence, Map };
+
+    // A parsed document in a few flat arrays instead of one heap object per node. A node is 12
+    // bytes whatever its kind, with no mark. The children of a container are stored next to each
+    // other, map keys and values interleaved, so a container is just the range of them; each
+    // range is placed when its container ends, the root comes last. Scalars are ranges of one
+    // string pool. An alias is a slot holding the index of its anchored node, which the accessors
+    // follow, so it is never handed out.
+    // A scalar spelled in the input exactly as its value reads is not copied at all, it stays a
+    // range of the input: a document built with a source must not outlive it.
+    // Read-only once built, so any number of threads can read it at once.
+    class Document {
+    public:
+        bool Empty() const { return nodes.empty(); }
+        Index Root() const { return root; }
+
+        Kind GetKind(Index node) const { return static_cast<Kind>(nodes[node].kind); }
+        const std::string& Tag(Index node) const { return tags[nodes[node].tag]; }
+        YAML::EmitterStyle::value Style(Index node) const;
+        std::string_view Scalar(Index node) const;
+        // Items of a sequence or entries of a map
+        size_t Size(Index node) const { return nodes[node].kind == static_cast<uint8_t>(Kind::Scalar) ? 0 : nodes[node].size; }
+        Index Item(Index sequence, size_t i) const { return Follow(nodes[sequence].begin + static_cast<Index>(i)); }
+        Index Key(Index map, size_t i) const { return Follow(nodes[map].begin + static_cast<Index>(2 * i)); }
+        Index Value(Index map, size_t i) const { return Follow(nodes[map].begin + static_cast<Index>(2 * i + 1)); }
+
+        // The value for a scalar key of a map, npos if there is none
+        Index Find(Index map, std::string_view key) const;
+        // Follows JSON pointer keys from the root, npos if one is missing
+        Index Navigate(const std::vector<std::string>& keys) const;
+
+        // Builds the subtree as yaml-cpp nodes, the same tree YAML::Load gives for it. A map entry
+        // whose value is skip is left out. Aliases within the subtree share one node again.
+        YAML::Node ToNode(Index node, Index skip = npos) const;
+
+        size_t NodeCount() const { return nodes.size(); }
+        size_t MemoryUsage() const;
+        // Scalars read from the source in place, and the bytes they did not need to copy
+        size_t BorrowedCount() const { return borrowed; }
+        size_t BorrowedBytes() const { return borrowedBytes; }
+
+    private:
+        friend class Builder;
+
+        struct Node {
+            uint8_t kind;   // Kind
+            uint8_t style;  // YAML::EmitterStyle, plus the bits below
+            uint16_t tag;   // into tags
+            uint32_t begin; // into strings, or source when borrowed, for a scalar, the first child of a
+                            // container, the anchored node for an alias
+            uint32_t size;  // bytes of a scalar, items of a sequence, entries of a map
+        };
+        static const uint8_t aliased_bit = 0x80;
+        static const uint8_t borrowed_bit = 0x40; // a scalar in source rather than strings
+        static const uint8_t alias_bit = 0x20;    // a slot standing for the node at begin
+
+        Index Follow(Index slot) const { return (nodes[slot].style & alias_bit) ? nodes[slot].begin : slot; }
+
+        YAML::Node Create(Index node, const YAML::Node& owner, std::unordered_map<Index, YAML::Node>& shared, bool& fill) const;
+
+        std::vector<Node> nodes;
+        Index root = 0;
+        std::string strings;
+        std::vector<std::string> tags;
+        const char* source = nullptr;
+        size_t borrowed = 0;
+        size_t borrowedBytes = 0;
+    };
+
+    // Builds a Document from the events of YAML::Parser or json::Parse. The document is complete
+    // with OnDocumentEnd, which places the root. Given the input the events are parsed from, a
+    // scalar found verbatim at the position of its mark is kept as a range of it: a plain or
+    // simply quoted one, without escapes, folding or indentation to undo.
+    class Builder : public YAML::EventHandler {
+    public:
+        explicit Builder(Document& document, const char* source = nullptr, size_t size = 0);
+
+        void OnDocumentStart(const YAML::Mark& mark) override;
+        void OnDocumentEnd() override;
+        void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override;
+        void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override;
+        void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override;
+        void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override;
+        void OnSequenceEnd() override;
+        void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override;
+        void OnMapEnd() override;
+
+    private:
+        // A node not placed yet, with its anchor, or for an alias the anchor it refers to
+        struct Pending {
+            Document::Node node;
+            YAML::anchor_t anchor;
+        };
+
+        Pending Make(Kind kind, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style);
+        void Open(const Pending& node);
+        void Close();
+        void Place(const Pending& node);
+        uint16_t TagId(const std::string& tag);
+        bool Borrow(Document::Node& node, const YAML::Mark& mark, const std::string& value);
+
+        Document& document;
+        size_t size;                 // of the source
+        std::vector<size_t> starts;  // where the children of each open container begin in pending
+        // the nodes of the open containers, each followed by its children so far; the root first
+        std::vector<Pending> pending;
+        // node of each anchor once it is placed, npos before. The parser numbers them across the
+        // stream, so a document built from part of it may only see a few high ones.
+        std::unordered_map<YAML::anchor_t, Index> anchors;
+        std::vector<std::pair<Index, YAML::anchor_t>> aliases; // placed alias slots, resolved at the end
+    };
+
+    // Parses the first document of a YAML or JSON stream, borrowing the scalars it can from data.
+    // Throws YAML::ParserException.
+    Document Load(const char* data, size_t size);
+}
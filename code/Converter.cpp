@@ -1,22 +1,430 @@
 #include "converter.h"
+#include "JsonParser.h"
+#include "JsonWriter.h"
+#include "MappedFile.h"
+#include "Streaming.h"
 #include "Util.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <optional>
 #include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "yaml-cpp/emitfromevents.h"
 #include "yaml-cpp/yaml.h"
 
+using Clock = std::chrono::steady_clock;
+
+// Appends to a string the caller owns, so its capacity survives between conversions
+class StringStreamBuf : public std::streambuf {
+public:
+    explicit StringStreamBuf(std::string& target) : target(target) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) target += traits_type::to_char_type(c);
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override {
+        target.append(data, static_cast<size_t>(size));
+        return size;
+    }
+
+private:
+    std::string& target;
+};
+
+namespace {
+    // Set while a task of a parallel conversion runs, edits to the shared document are queued here
+    thread_local std::vector<std::function<void()>>* sharedEdits = nullptr;
+
+    struct SharedEditQueue {
+        explicit SharedEditQueue(std::vector<std::function<void()>>& queue) { sharedEdits = &queue; }
+        ~SharedEditQueue() { sharedEdits = nullptr; }
+    };
+
+    // Thrown by a task whose edits cannot be replayed later, the conversion falls back to serial
+    struct SerialRequired {};
+
+    // Writes nodes and parser events through one EmitFromEvents as the parts of a single document.
+    // Anchors are numbered across all of them, and a node anchored where it was first written is
+    // an alias wherever it comes again, as if the document went through one emitter << node.
+    class DocumentEvents {
+    public:
+        explicit DocumentEvents(YAML::Emitter& emitter) : events(emitter) {}
+
+        // With the whole document counted up front, a node reached twice anywhere in it is
+        // anchored. Otherwise Write counts the references within each node it is given.
+        void Count(const YAML::Node& document) {
+            if (document.GetNode()) Count(*document.GetNode());
+            counted = true;
+        }
+
+        void Write(const YAML::Node& node) {
+            if (!node.GetNode()) return;
+            if (!counted) {
+                refCount.clear();
+                Count(*node.GetNode());
+            }
+            Write(*node.GetNode());
+        }
+
+        // The events of a value report hands over, with their anchors renumbered into the document
+        void Pipe(const std::function<void(YAML::EventHandler&)>& report) {
+            Renumbered renumbered(*this);
+            report(renumbered);
+        }
+
+    private:
+        // ordered, as in yaml-cpp's NodeEvents; hashing every node of a large document was slower
+        using Ref = const YAML::detail::node_ref*;
+
+        class Renumbered : public YAML::EventHandler {
+        public:
+            explicit Renumbered(DocumentEvents& document) : document(document) {}
+
+            void OnDocumentStart(const YAML::Mark&) override {}
+            void OnDocumentEnd() override {}
+            void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                document.events.OnNull(mark, Anchor(anchor));
+            }
+            // the structural index does not split entries at aliases, so the anchor was piped too
+            void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                document.events.OnAlias(mark, anchors.at(anchor));
+            }
+            void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override {
+                document.events.OnScalar(mark, tag, Anchor(anchor), value);
+            }
+            void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                document.events.OnSequenceStart(mark, tag, Anchor(anchor), style);
+            }
+            void OnSequenceEnd() override { document.events.OnSequenceEnd(); }
+            void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                document.events.OnMapStart(mark, tag, Anchor(anchor), style);
+            }
+            void OnMapEnd() override { document.events.OnMapEnd(); }
+
+        private:
+            YAML::anchor_t Anchor(YAML::anchor_t anchor) {
+                if (anchor == YAML::NullAnchor) return anchor;
+                return anchors[anchor] = ++document.lastAnchor;
+            }
+
+            DocumentEvents& document;
+            std::unordered_map<YAML::anchor_t, YAML::anchor_t> anchors;
+        };
+
+        void Count(const YAML::detail::node& node) {
+            if (++refCount[node.ref()] > 1) return;
+            if (node.type() == YAML::NodeType::Sequence) {
+                for (auto element : node) Count(*element);
+            }
+            else if (node.type() == YAML::NodeType::Map) {
+                for (auto element : node) {
+                    Count(*element.first);
+                    Count(*element.second);
+                }
+            }
+        }
+
+        void Write(const YAML::detail::node& node) {
+            YAML::anchor_t anchor = YAML::NullAnchor;
+            if (!anchors.empty()) {
+                auto found = anchors.find(node.ref());
+                if (found != anchors.end()) {
+                    events.OnAlias(YAML::Mark(), found->second);
+                    return;
+                }
+            }
+            if (refCount[node.ref()] > 1) {
+                anchor = anchors[node.ref()] = ++lastAnchor;
+            }
+
+            switch (node.type()) {
+            case YAML::NodeType::Undefined:
+                break;
+            case YAML::NodeType::Null:
+                events.OnNull(YAML::Mark(), anchor);
+                break;
+            case YAML::NodeType::Scalar:
+                events.OnScalar(YAML::Mark(), node.tag(), anchor, node.scalar());
+                break;
+            case YAML::NodeType::Sequence:
+                events.OnSequenceStart(YAML::Mark(), node.tag(), anchor, node.style());
+                for (auto element : node) Write(*element);
+                events.OnSequenceEnd();
+                break;
+            case YAML::NodeType::Map:
+                events.OnMapStart(YAML::Mark(), node.tag(), anchor, node.style());
+                for (auto element : node) {
+                    Write(*element.first);
+                    Write(*element.second);
+                }
+                events.OnMapEnd();
+                break;
+            }
+        }
+
+        YAML::EmitFromEvents events;
+        std::map<Ref, int> refCount;
+        std::map<Ref, YAML::anchor_t> anchors;
+        YAML::anchor_t lastAnchor = 0;
+        bool counted = false;
+    };
+}
+
+static double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Writes the converted document one top-level entry at a time in either output format, so the
+// paths can be written while they are converted. Adds up the time spent writing. Given the whole
+// document up front, the YAML anchors are those one emitter << document would write.
+class ResultWriter {
+public:
+    ResultWriter(std::ostream& out, OutputFormat format, const YAML::Node* document = nullptr) : out(out) {
+        auto start = Clock::now();
+        if (format == OutputFormat::Json) {
+            writer.emplace(out);
+            writer->BeginObject();
+        }
+        else {
+            emitter.emplace(out);
+            events.emplace(*emitter);
+            if (document) events->Count(*document);
+            *emitter << YAML::BeginMap;
+        }
+        ms += ElapsedMs(start);
+    }
+
+    void Member(const std::string& key, const YAML::Node& value) {
+        if (!value.IsDefined()) return;
+        auto start = Clock::now();
+        if (writer) {
+            writer->Member(key, value);
+        }
+        else {
+            *emitter << YAML::Key << key << YAML::Value;
+            // the emitter does not quote by tag, "2.0" would read back as a number
+            if (key == "swagger") {
+                *emitter << YAML::DoubleQuoted << value.Scalar();
+            }
+            else {
+                events->Write(value);
+            }
+        }
+        ms += ElapsedMs(start);
+    }
+
+    // A map member whose entries follow one Entry at a time, in the style the node would have
+    void BeginMap(const std::string& key, YAML::EmitterStyle::value style) {
+        auto start = Clock::now();
+        if (writer) {
+            writer->BeginObject(key);
+        }
+        else {
+            *emitter << YAML::Key << key << YAML::Value;
+            if (style == YAML::EmitterStyle::Flow) *emitter << YAML::Flow;
+            else if (style == YAML::EmitterStyle::Block) *emitter << YAML::Block;
+            emitter->RestoreGlobalModifiedSettings();
+            *emitter << YAML::BeginMap;
+        }
+        ms += ElapsedMs(start);
+    }
+
+    void Entry(const YAML::Node& key, const YAML::Node& value) {
+        auto start = Clock::now();
+        if (writer) {
+            writer->Member(key.IsScalar() ? key.Scalar() : YAML::Dump(key), value);
+        }
+        else {
+            *emitter << YAML::Key;
+            events->Write(key);
+            *emitter << YAML::Value;
+            events->Write(value);
+        }
+        ms += ElapsedMs(start);
+    }
+
+    // A member whose value report hands over as parser events, written without building it
+    void Pipe(const std::string& key, const std::function<void(YAML::EventHandler&)>& report) {
+        auto start = Clock::now();
+        if (writer) {
+            writer->Member(key, report);
+        }
+        else {
+            *emitter << YAML::Key << key << YAML::Value;
+            events->Pipe(report);
+        }
+        ms += ElapsedMs(start);
+    }
+
+    void EndMap() {
+        auto start = Clock::now();
+        if (writer) writer->EndObject();
+        else *emitter << YAML::EndMap;
+        ms += ElapsedMs(start);
+    }
+
+    void Finish() {
+        auto start = Clock::now();
+        if (writer) {
+            writer->EndObject();
+            writer->Flush();
+        }
+        else {
+            *emitter << YAML::EndMap;
+        }
+        out.flush();
+        ms += ElapsedMs(start);
+    }
+
+    double WriteMs() const { return ms; }
+
+private:
+    std::ostream& out;
+    std::optional<json::Writer> writer;
+    std::optional<YAML::Emitter> emitter;
+    std::optional<DocumentEvents> events;
+    double ms = 0;
+};
+
 const std::array<std::string, 8> http_methods = {"get", "put", "post", "delete", "options", "head", "patch", "trace"};
 const std::vector<std::string> schema_properties = { "format", "minimum", "maximum", "exclusiveMinimum", "exclusiveMaximum", "minLength", "maxLength", "multipleOf", "minItems", "maxItems", "uniqueItems", "minProperties", "maxProperties", "additionalProperties", "pattern", "enum", "default" };
 const std::vector<std::string> array_properties = { "type", "items" };
+// Top-level entries of the result after "swagger", in the order they are written
+const std::array<std::string, 8> result_keys = { "info", "host", "basePath", "schemes", "paths", "definitions", "securityDefinitions", "x-components" };
+// entries the conversion reads, the others only matter once a $ref reaches them
+const std::array<std::string, 11> input_pointers = { "#/openapi", "#/servers", "#/host", "#/basePath", "#/schemes", "#/components",
+    "#/components/schemas", "#/components/securitySchemes", "#/definitions", "#/securityDefinitions", "#/x-components" };
+// Maps with this many entries get their entries indexed when a pointer walks through them
+const size_t wide_map_size = 64;
+
+
+// Indexes every node down to depth levels below pointer, which covers #/components/<kind>/<name>
+// and #/paths/<path>/<method>, the targets of nearly all references
+void Converter::IndexPointers(const YAML::Node& node, const std::string& pointer, int depth) {
+    pointers.emplace(pointer, node);
+    if (depth == 0) return;
+    if (node.IsMap()) {
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            if (it->first.IsScalar()) {
+                IndexPointers(it->second, pointer + "/" + util::EncodeKey(it->first.Scalar()), depth - 1);
+            }
+        }
+    }
+    else if (node.IsSequence()) {
+        for (size_t i = 0; i < node.size(); ++i) {
+            IndexPointers(node[i], pointer + "/" + std::to_string(i), depth - 1);
+        }
+    }
+}
+
+// Read-only, so it is safe from the tasks of a parallel conversion
+YAML::Node Converter::LookupPointer(const std::string& ref) {
+    auto found = pointers.find(ref);
+    if (found != pointers.end()) {
+        ++refHits;
+        return found->second;
+    }
+    ++refMisses;
+    // path items are not part of input while converting from a compact document
+    if (source && ref.compare(0, 8, "#/paths/") == 0) {
+        compact::Index node = source->Navigate(util::SplitAndDecode(ref));
+        if (node != compact::npos) return source->ToNode(node);
+    }
+    // an entry the first pass left unparsed is parsed and indexed the first time a $ref reaches it
+    if (outline) {
+        std::string pointer;
+        YAML::Node entry = LoadDeferred(ref, pointer);
+        if (entry && parallel) {
+            // the index is read-only, so the task walks the entry it parsed for itself
+            for (const auto& key : util::SplitAndDecode(ref.substr(pointer.size()))) {
+                entry.reset(util::Child(entry, key));
+                if (!entry) {
+                    std::cerr << "Key not found: " << key << std::endl;
+                    return YAML::Node();
+                }
+            }
+            return entry;
+        }
+        if (entry) {
+            found = pointers.find(ref);
+            if (found != pointers.end()) return found->second;
+        }
+    }
+    size_t split = ref.size();
+    while (found == pointers.end() && split > 0 && (split = ref.rfind('/', split - 1)) != std::string::npos) {
+        found = pointers.find(ref.substr(0, split));
+    }
+    if (found == pointers.end()) {
+        std::cerr << "Key not found: " << ref << std::endl;
+        return YAML::Node();
+    }
+
+    // Walk on from there. The entries of wide maps on the way are added to the index, yaml-cpp
+    // looks keys up by scanning the map, so the next pointer into one of them is a hit instead.
+    // Tasks of a parallel conversion leave the index as it is.
+    std::string pointer = found->first;
+    YAML::Node cur = found->second;
+    for (const auto& key : util::SplitAndDecode(ref.substr(split))) {
+        std::string childPointer = pointer + "/" + util::EncodeKey(key);
+        if (!parallel && cur.IsMap() && cur.size() >= wide_map_size) {
+            IndexPointers(cur, pointer, 1);
+            found = pointers.find(childPointer);
+            if (found == pointers.end()) {
+                std::cerr << "Key not found: " << key << std::endl;
+                return YAML::Node();
+            }
+            cur.reset(found->second);
+        }
+        else {
+            YAML::Node child = util::Child(cur, key);
+            if (!child) {
+                std::cerr << "Key not found: " << key << std::endl;
+                return YAML::Node();
+            }
+            cur.reset(child);
+        }
+        pointer.swap(childPointer);
+    }
+    return cur;
+}
 
+// The value of the deferred entry ref points into, parsed on first use. Outside of a parallel
+// conversion it is kept and indexed like the rest of input.
+YAML::Node Converter::LoadDeferred(const std::string& ref, std::string& pointer) {
+    for (const streaming::Deferred& part : outline->deferred) {
+        if (ref.compare(0, part.pointer.size(), part.pointer) != 0) continue;
+        if (ref.size() != part.pointer.size() && ref[part.pointer.size()] != '/') continue;
+        pointer = part.pointer;
+        auto found = loaded.find(pointer);
+        if (found != loaded.end()) return found->second;
+        compact::Document document = streaming::ReadEntry(streamData, *outline, part);
+        YAML::Node entry = document.ToNode(document.Value(document.Root(), 0));
+        if (!parallel) {
+            loaded.emplace(pointer, entry);
+            int levels = static_cast<int>(std::count(pointer.begin(), pointer.end(), '/'));
+            IndexPointers(entry, pointer, 3 - levels);
+        }
+        return entry;
+    }
+    return YAML::Node();
+}
 
 YAML::Node Converter::ResolveReference(YAML::Node obj, bool shouldClone) {
 
-	if (!obj || !obj["$ref"]) return obj;
+	if (!obj || !util::Has(obj, "$ref")) return obj;
     auto ref = obj["$ref"].as<std::string>();
     if (ref[0]=='#') {
-        std::vector<std::string> keys = util::SplitAndDecode(ref);
-        YAML::Node cur = obj;
-        YAML::Node result = util::Navigate(cur, keys);
+        YAML::Node result = LookupPointer(ref);
 
         return shouldClone ? YAML::Clone(result) : result;
     }
@@ -30,7 +438,7 @@ void Converter::ConvertInfos() {
 
         if (variables && variables.IsMap()) {
             for (auto it = variables.begin(); it != variables.end(); ++it) {
-                std::string variableName = it->first.as<std::string>();
+                const std::string& variableName = util::Text(it->first);
                 YAML::Node variableObject = it->second;
 
                 if (variableObject["default"]) {
@@ -64,8 +472,8 @@ void Converter::ConvertInfos() {
 	input.remove("servers");
     input.remove("openapi");
 }
-
 void Converter::ConvertDiscriminatorMapping(YAML::Node mapping) {
+    if (sharedEdits) throw SerialRequired();
     for (auto it = mapping.begin(); it != mapping.end(); ++it) {
         std::string payload = it->first.as<std::string>();
         std::string schemaNameOrRef = it->second.as<std::string>();
@@ -79,23 +487,24 @@ void Converter::ConvertDiscriminatorMapping(YAML::Node mapping) {
         std::regex schemaNameRegex(R"(^[a-zA-Z0-9._-]+$)");
         if (std::regex_match(schemaNameOrRef, schemaNameRegex)) {
             try {
-                schema = ResolveReference(YAML::Node(YAML::NodeType::Map)["$ref"] = "#/components/schemas/" + schemaNameOrRef, false);
+                schema = LookupPointer("#/components/schemas/" + schemaNameOrRef);
             }
             catch (const std::exception& err) {
                 std::cerr << "Error resolving " << schemaNameOrRef << " for " << payload << " as schema name in discriminator.mapping: " << err.what() << std::endl;
             }
         }
 
-        if (!schema) {
+        // a failed lookup leaves a null node, and assigning to a bound node would overwrite its target
+        if (!schema.IsMap() && schemaNameOrRef[0] == '#') {
             try {
-                schema = ResolveReference(YAML::Node(YAML::NodeType::Map)["$ref"] = schemaNameOrRef, false);
+                schema.reset(LookupPointer(schemaNameOrRef));
             }
             catch (const std::exception& err) {
                 std::cerr << "Error resolving " << schemaNameOrRef << " for " << payload << " in discriminator.mapping: " << err.what() << std::endl;
             }
         }
 
-        if (schema) {
+        if (schema.IsMap()) {
             schema["x-discriminator-value"] = payload;
             schema["x-ms-discriminator-value"] = payload;
         }
@@ -105,99 +514,212 @@ void Converter::ConvertDiscriminatorMapping(YAML::Node mapping) {
     }
 }
 
-void Converter::ConvertSchema(YAML::Node def, const std::string& operationDirection) {
-    if (def["oneOf"]) {
-        def.remove("oneOf");
-        if (def["discriminator"]) {
-            def.remove("discriminator");
-        }
-    }
+// A schema on the work stack of ConvertSchema. One scan over its entries finds every keyword the
+// rewrites need, rather than a lookup per keyword, each of which scans the map and adds an entry
+// when the key is missing.
+struct Converter::SchemaFrame {
+    enum class Stage { Enter, AllOf, Properties, Done };
 
-    if (def["anyOf"]) {
-        def.remove("anyOf");
-        if (def["discriminator"]) {
-            def.remove("discriminator");
-        }
-    }
+    explicit SchemaFrame(const YAML::Node& def) : def(def) {}
+
+    YAML::Node def;
+    Stage stage = Stage::Enter;
+    YAML::Node allOf, discriminator, properties, items, deprecated;
+    std::string type;
+    bool hasOneOf = false, hasAnyOf = false, hasAllOf = false, hasDiscriminator = false, hasProperties = false,
+        hasItems = false, hasNullable = false, hasDeprecated = false, hasXDeprecated = false;
+    bool visitProperties = false, visitItems = false;
+    YAML::iterator next, end;         // the allOf item or property to visit next
+    YAML::Node converted;             // the property visited last, it loses writeOnly once converted
+    bool hasConverted = false;
+    std::vector<std::string> removed; // writeOnly properties of a response schema
 
-    if (def["allOf"]) {
-        for (auto item : def["allOf"]) {
-            ConvertSchema(item, operationDirection);
+    void Scan() {
+        if (!def.IsMap()) {
+            def["oneOf"]; // turns a null schema into an empty map, and throws on a scalar
+        }
+        for (const auto& entry : util::NodeView(def)) {
+            const std::string& key = entry.first.Scalar();
+            if (key.empty()) continue;
+            auto take = [&](YAML::Node& node, bool& has) {
+                if (!has) {
+                    node.reset(entry.second.Bind(def));
+                    has = true;
+                }
+            };
+            switch (key[0]) {
+            case 'o': if (key == "oneOf") hasOneOf = true; break;
+            case 'a': if (key == "anyOf") hasAnyOf = true; else if (key == "allOf") take(allOf, hasAllOf); break;
+            case 'd':
+                if (key == "discriminator") take(discriminator, hasDiscriminator);
+                else if (key == "deprecated") take(deprecated, hasDeprecated);
+                break;
+            case 't': if (key == "type" && type.empty()) type = entry.second.IsNull() ? "null" : entry.second.Scalar(); break;
+            case 'p': if (key == "properties") take(properties, hasProperties); break;
+            case 'i': if (key == "items") take(items, hasItems); break;
+            case 'n': if (key == "nullable") hasNullable = true; break;
+            case 'x': if (key == "x-deprecated") hasXDeprecated = true; break;
+            }
         }
     }
+};
 
-    if (def["discriminator"]) {
-        if (def["discriminator"]["mapping"]) {
-            ConvertDiscriminatorMapping(def["discriminator"]["mapping"]);
+// Walks the schema with a work stack on the heap rather than recursion, so deeply nested schemas
+// cannot overflow the stack of a worker thread. With fixRefs, $refs are rewritten in the same
+// pass: the subschemas are visited anyway, and everything else below them goes to util::FixRefs.
+void Converter::ConvertSchema(YAML::Node def, const std::string& operationDirection, bool fixRefs) {
+    std::vector<SchemaFrame> stack;
+    stack.emplace_back(def);
+    while (!stack.empty()) {
+        YAML::Node child;
+        if (NextSubschema(stack.back(), operationDirection, child)) {
+            if (stack.size() >= options.maxDepth) {
+                throw std::runtime_error("Schema is nested more than " + std::to_string(options.maxDepth) + " levels deep");
+            }
+            stack.emplace_back(child);
+        }
+        else {
+            FinishSchema(stack.back(), fixRefs);
+            stack.pop_back();
         }
-        def["discriminator"] = def["discriminator"]["propertyName"];
     }
+}
 
-    std::string type = def["type"].as<std::string>("");
-    if (type == "object") {
-        if (def["properties"]) {
-            for (auto it = def["properties"].begin(); it != def["properties"].end(); ++it) {
-                std::string propName = it->first.as<std::string>();
-                YAML::Node prop = it->second;
-                if (prop["writeOnly"] && prop["writeOnly"].as<bool>() == true && operationDirection == "response") {
-                    def["properties"].remove(propName);
+// Applies the rewrites that come before each subschema of the frame and hands out that subschema,
+// in the order a recursive walk would visit them. False once all of them are converted.
+bool Converter::NextSubschema(SchemaFrame& frame, const std::string& operationDirection, YAML::Node& child) {
+    switch (frame.stage) {
+    case SchemaFrame::Stage::Enter:
+        frame.Scan();
+        if (frame.hasOneOf) frame.def.remove("oneOf");
+        if (frame.hasAnyOf) frame.def.remove("anyOf");
+        if ((frame.hasOneOf || frame.hasAnyOf) && frame.hasDiscriminator) {
+            frame.def.remove("discriminator");
+            frame.hasDiscriminator = false;
+        }
+        if (frame.hasAllOf) {
+            frame.next = frame.allOf.begin();
+            frame.end = frame.allOf.end();
+        }
+        frame.stage = SchemaFrame::Stage::AllOf;
+        // fall through
+    case SchemaFrame::Stage::AllOf:
+        if (frame.hasAllOf && frame.next != frame.end) {
+            child.reset(*frame.next);
+            ++frame.next;
+            return true;
+        }
+        if (frame.hasDiscriminator) {
+            YAML::Node mapping = util::Find(frame.discriminator, "mapping");
+            if (mapping) {
+                ConvertDiscriminatorMapping(mapping);
+            }
+            frame.discriminator = frame.discriminator["propertyName"];
+        }
+        frame.visitProperties = frame.type == "object" && frame.hasProperties;
+        frame.visitItems = frame.type == "array" && frame.hasItems;
+        if (frame.visitProperties) {
+            frame.next = frame.properties.begin();
+            frame.end = frame.properties.end();
+        }
+        frame.stage = SchemaFrame::Stage::Properties;
+        // fall through
+    case SchemaFrame::Stage::Properties:
+        if (frame.visitProperties) {
+            if (frame.hasConverted) {
+                frame.converted.remove("writeOnly");
+                frame.hasConverted = false;
+            }
+            while (frame.next != frame.end) {
+                auto entry = *frame.next;
+                ++frame.next;
+                YAML::Node prop = entry.second;
+                YAML::Node writeOnly = util::Find(prop, "writeOnly");
+                if (writeOnly && writeOnly.as<bool>() == true && operationDirection == "response") {
+                    frame.removed.push_back(entry.first.as<std::string>());
                 }
                 else {
-                    ConvertSchema(prop, operationDirection);
-                    prop.remove("writeOnly");
+                    frame.converted.reset(prop);
+                    frame.hasConverted = true;
+                    child.reset(prop);
+                    return true;
                 }
             }
         }
-    }
-    else if (type == "array") {
-        if (def["items"]) {
-            ConvertSchema(def["items"], operationDirection);
+        frame.stage = SchemaFrame::Stage::Done;
+        if (frame.visitItems) {
+            child.reset(frame.items);
+            return true;
         }
+        return false;
+    case SchemaFrame::Stage::Done:
+        return false;
     }
+    return false;
+}
 
-    if (def["nullable"]) {
+// The rewrites that come after the subschemas of the frame are converted
+void Converter::FinishSchema(SchemaFrame& frame, bool fixRefs) {
+    YAML::Node& def = frame.def;
+    if (!frame.removed.empty()) {
+        util::RemoveKeys(frame.properties, frame.removed);
+    }
+
+    if (frame.hasNullable) {
         def["x-nullable"] = true;
         def.remove("nullable");
     }
 
-    if (def["deprecated"]) {
-        if (!def["x-deprecated"]) {
-            def["x-deprecated"] = def["deprecated"];
+    if (frame.hasDeprecated) {
+        if (!frame.hasXDeprecated) {
+            def["x-deprecated"] = frame.deprecated;
         }
         def.remove("deprecated");
     }
+
+    if (fixRefs) {
+        for (auto it = def.begin(); it != def.end(); ++it) {
+            const std::string& key = it->first.Scalar();
+            YAML::Node value = it->second;
+            if (key == "$ref") {
+                value = util::FixRef(value.as<std::string>());
+            }
+            else if (!(key == "allOf" && frame.hasAllOf) && !(key == "properties" && frame.visitProperties) && !(key == "items" && frame.visitItems)) {
+                util::FixRefs(value, options.maxDepth);
+            }
+        }
+    }
 }
 
 
 void Converter::ConvertOperationParameters(YAML::Node& operation) {
-    YAML::Node content, param;
+    YAML::Node param;
     std::string contentKey;
     std::vector<std::string> mediaRanges, mediaTypes;
 
-    if (!operation["parameters"]) {
+    if (!util::Has(operation, "parameters")) {
         operation["parameters"] = YAML::Node(YAML::NodeType::Sequence);
     }
+    YAML::Node parameters = util::Find(operation, "parameters");
 
-    if (operation["requestBody"]) {
-        param = ResolveReference(operation["requestBody"], true);
+    YAML::Node requestBody = util::Find(operation, "requestBody");
+    if (requestBody) {
+        param = ResolveReference(requestBody, true);
 
         // Fixing external $ref in body
-        if (operation["requestBody"]["content"]) {
-            auto supportedMimeTypes = util::GetSupportedMimeTypes(operation["requestBody"]["content"]);
+        YAML::Node bodyContent = util::Find(requestBody, "content");
+        if (bodyContent) {
+            auto supportedMimeTypes = util::GetSupportedMimeTypes(bodyContent);
             if (!supportedMimeTypes.empty()) {
-                std::string type = supportedMimeTypes[0];
-                YAML::Node structuredObj = YAML::Node(YAML::NodeType::Map);
-                structuredObj["content"] = YAML::Node(YAML::NodeType::Map);
-                YAML::Node data = operation["requestBody"]["content"][type];
-
-                if (data && data["schema"] && data["schema"]["$ref"] && data["schema"]["$ref"].as<std::string>()[0] != '#') {
+                util::NodeView ref = util::NodeView(bodyContent)[supportedMimeTypes[0]]["schema"]["$ref"];
+                if (ref && ref.Scalar()[0] != '#') {
                     std::cerr << "external refs aren't supported" << std::endl;
                 }
             }
         }
 
         param["name"] = "body";
-        content = param["content"];
+        YAML::Node content = util::Find(param, "content");
         if (content && content.size() > 0) {
             mediaRanges = util::GetMediaRanges(content);
             mediaTypes = util::GetMediaTypes(mediaRanges);
@@ -211,53 +733,59 @@ void Converter::ConvertOperationParameters(YAML::Node& operation) {
                     param["in"] = "formData";
                     param["schema"] = content[contentKey]["schema"];
                     param["schema"] = ResolveReference(content[contentKey]["schema"], true);
-                    if (param["schema"]["type"].as<std::string>() == "object" && param["schema"]["properties"]) {
-                        auto required = param["schema"]["required"];
-                        for (const auto& name : param["schema"]["properties"]) {
-                            std::string varName = name.first.as<std::string>();
-                            YAML::Node schema = param["schema"]["properties"][varName];
-                            if (!schema["readOnly"]) {
-                                YAML::Node formDataParam;
+                    YAML::Node bodySchema = param["schema"];
+                    YAML::Node properties = util::Find(bodySchema, "properties");
+                    if (util::Text(bodySchema["type"]) == "object" && properties) {
+                        YAML::Node required = util::Find(bodySchema, "required");
+                        for (const auto& name : properties) {
+                            const std::string& varName = util::Text(name.first);
+                            YAML::Node schema = name.second;
+                            if (!util::Has(schema, "readOnly")) {
+                                // made in the memory of the document, so linking it in merges nothing
+                                YAML::Node formDataParam = util::NewNode(parameters, YAML::NodeType::Map);
                                 formDataParam["name"] = varName;
                                 formDataParam["in"] = "formData";
                                 formDataParam["schema"] = schema;
                                 for (const auto& reqProp : required) {
-                                    if (reqProp.as<std::string>() == varName) {
+                                    if (util::Text(reqProp) == varName) {
                                         formDataParam["required"] = true;
                                         break;
                                     }
                                 }
-                                operation["parameters"].push_back(formDataParam);
+                                parameters.push_back(formDataParam);
                             }
                         }
                     }
                     else {
-                        operation["parameters"].push_back(param);
+                        parameters.push_back(param);
                     }
                 }
                 else if (!contentKey.empty()) {
                     operation["consumes"] = mediaTypes;
                     param["in"] = "body";
                     param["schema"] = content[contentKey]["schema"];
-                    operation["parameters"].push_back(param);
+                    parameters.push_back(param);
                 }
                 else if (!mediaRanges.empty()) {
                     operation["consumes"] = !mediaTypes.empty() ? mediaTypes : std::vector<std::string>{ "application/octet-stream" };
                     param["in"] = "body";
-                    param["name"] = param["name"] ? param["name"].as<std::string>() : "file";
+                    YAML::Node name = util::Find(param, "name");
+                    param["name"] = name ? name.as<std::string>() : "file";
                     param.remove("type");
-                    if (content[mediaRanges[0]]["schema"]) {
-                        param["schema"] = content[mediaRanges[0]]["schema"];
+                    YAML::Node schema = util::Find(util::Find(content, mediaRanges[0]), "schema");
+                    if (schema) {
+                        param["schema"] = schema;
                     }
                     else {
                         param["schema"]["type"] = "string";
                         param["schema"]["format"] = "binary";
                     }
-                    operation["parameters"].push_back(param);
+                    parameters.push_back(param);
                 }
 
-                if (param["schema"]) {
-                    ConvertSchema(param["schema"], "request");
+                YAML::Node schema = util::Find(param, "schema");
+                if (schema) {
+                    ConvertSchema(schema, "request");
                 }
             }
         }
@@ -268,48 +796,53 @@ void Converter::ConvertOperationParameters(YAML::Node& operation) {
 
 void Converter::ConvertResponses(YAML::Node& operation) {
 
-    for (auto it = operation["responses"].begin(); it != operation["responses"].end(); ++it) {
-        auto code = it->first.as<std::string>();
+    YAML::Node responses = util::Find(operation, "responses");
+    for (auto it = responses.begin(); it != responses.end(); ++it) {
+        const std::string& code = util::Text(it->first);
         auto response = ResolveReference(it->second, true);
-        if (response["content"]) {
+        // an empty response, header or path item is written as an empty map
+        if (response.IsNull()) response = YAML::Node(YAML::NodeType::Map);
+        YAML::Node contents = util::Find(response, "content");
+        if (contents) {
             auto anySchema = YAML::Node();
             auto jsonSchema = YAML::Node();
 
-            for (auto contentIt = response["content"].begin(); contentIt != response["content"].end(); ++contentIt) {
-                auto mediaRange = contentIt->first.as<std::string>();
+            for (const auto& entry : util::NodeView(contents)) {
+                auto mediaRange = entry.first.Scalar();
                 auto mediaType = (mediaRange.find('*') == std::string::npos) ? mediaRange : "application/octet-stream";
-                auto produces = operation["produces"];
-                if (!operation["produces"]) {
+                YAML::Node produces = util::Find(operation, "produces");
+                if (!produces) {
                     operation["produces"] = YAML::Node(YAML::NodeType::Sequence);
                     operation["produces"].push_back(mediaType);
                 }
                 else {
                     bool found = false;
-                    for (const auto& existing : operation["produces"]) {
-                        if (existing.as<std::string>() == mediaType) {
+                    for (const auto& existing : util::NodeView(produces)) {
+                        if (existing.Scalar() == mediaType) {
                             found = true;
                             break;
                         }
                     }
                     if (!found) {
-                        operation["produces"].push_back(mediaType);
+                        produces.push_back(mediaType);
                     }
                 }
 
-                auto content = response["content"][mediaRange];
+                util::NodeView schema = entry.second["schema"];
 
-                if (anySchema.IsNull() && content["schema"]) {
-                    anySchema = content["schema"];
+                if (anySchema.IsNull() && schema) {
+                    anySchema = schema.Bind(contents);
                 }
-                if (jsonSchema.IsNull() && util::IsJsonMimeType(mediaType) && content["schema"]) {
-                    jsonSchema = content["schema"];
+                if (jsonSchema.IsNull() && util::IsJsonMimeType(mediaType) && schema) {
+                    jsonSchema = schema.Bind(contents);
                 }
 
-                if (content["example"]) {
-                    if (!response["examples"]) {
+                util::NodeView example = entry.second["example"];
+                if (example) {
+                    if (!util::Has(response, "examples")) {
                         response["examples"] = YAML::Node(YAML::NodeType::Map);
                     }
-                    response["examples"][mediaType] = content["example"];
+                    response["examples"][mediaType] = example.Bind(contents);
                 }
             }
 
@@ -320,140 +853,217 @@ void Converter::ConvertResponses(YAML::Node& operation) {
             }
         }
 
-        auto headers = response["headers"];
+        YAML::Node headers = util::Find(response, "headers");
         if (headers) {
             for (auto headerIt = headers.begin(); headerIt != headers.end(); ++headerIt) {
-                std::string header = headerIt->first.as<std::string>();
+                const std::string& header = util::Text(headerIt->first);
                 auto resolved = ResolveReference(headerIt->second, true);
+                if (resolved.IsNull()) resolved = YAML::Node(YAML::NodeType::Map);
 
-                if (resolved["schema"]) {
-                    resolved["type"] = resolved["schema"]["type"];
-                    resolved["format"] = resolved["schema"]["format"];
+                YAML::Node schema = util::Find(resolved, "schema");
+                if (schema) {
+                    resolved["type"] = schema["type"];
+                    resolved["format"] = schema["format"];
                     resolved.remove("schema");
                 }
                 headers[header] = resolved;
             }
         }
         response.remove("content");
-        operation["responses"][code] = response;
+        responses[code] = response;
         
     }
 }
 
+void Converter::ConvertPathItem(const YAML::Node& item) {
+    YAML::Node pathObject = ResolveReference(item, true);
+    if (pathObject.IsNull()) pathObject = YAML::Node(YAML::NodeType::Map);
+
+    ConvertParameters(pathObject);
+    for (auto method = pathObject.begin(); method != pathObject.end(); ++method) {
+        const std::string& methodName = util::Text(method->first);
+        auto it = std::find(http_methods.begin(), http_methods.end(), methodName);
+        if (it != http_methods.end()) {
+            auto operation = ResolveReference(method->second, true);
+            ConvertOperationParameters(operation);
+            ConvertResponses(operation);
+        }
+    }
+}
+
 void Converter::ConvertOperations(){
     YAML::Node paths = input["paths"];
+    if (options.threads != 1 && ConvertInParallel(paths, [this](YAML::Node& item) { ConvertPathItem(item); })) {
+        return;
+    }
     for (auto path = paths.begin(); path != paths.end(); ++path) {
-        YAML::Node pathObject = ResolveReference(path->second, true);
+        ConvertPathItem(path->second);
+    }
+}
 
-        
-        ConvertParameters(pathObject);
-        for (auto method = pathObject.begin(); method != pathObject.end(); ++method) {
-            std::string methodName = method->first.as<std::string>();
-            auto it = std::find(http_methods.begin(), http_methods.end(), methodName);
-            if (it != http_methods.end()) {
-                auto operation = ResolveReference(method->second, true);
-                ConvertOperationParameters(operation);
-                ConvertResponses(operation);
-            }
+// yaml-cpp keeps all nodes of a document in one detail::memory, which is not thread-safe, and even
+// a lookup can add nodes to it. Each task therefore clones its entry into a memory of its own,
+// reading the shared tree only, and the converted clones are linked back in order afterwards.
+// Edits to shared nodes, i.e. referenced component parameters, are queued and replayed in entry
+// order. Discriminator mappings edit other entries, so a map holding one is converted serially.
+// Anchors shared between entries end up as separate copies.
+bool Converter::ConvertInParallel(YAML::Node& map, const std::function<void(YAML::Node&)>& convert) {
+    std::vector<YAML::Node> entries;
+    entries.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        entries.push_back(it->second);
+    }
+    std::vector<YAML::Node> converted(entries.size());
+    std::vector<std::vector<std::function<void()>>> edits(entries.size());
+    try {
+        struct Running {
+            bool& flag;
+            explicit Running(bool& flag) : flag(flag) { flag = true; }
+            ~Running() { flag = false; }
+        } running(parallel);
+        util::ParallelFor(entries.size(), options.threads, [&](size_t i) {
+            SharedEditQueue queue(edits[i]);
+            converted[i] = YAML::Clone(entries[i]);
+            convert(converted[i]);
+        });
+    }
+    catch (const SerialRequired&) {
+        return false; // nothing of the document was touched yet
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i] = converted[i];
+    }
+    for (auto& entryEdits : edits) {
+        for (auto& edit : entryEdits) {
+            edit();
         }
     }
+    return true;
+}
+
+void Converter::EditShared(std::function<void()> edit) {
+    if (sharedEdits) {
+        sharedEdits->push_back(std::move(edit));
+    }
+    else {
+        edit();
+    }
 }
 
 void Converter::CopySchemaProperties (YAML::Node& node, std::vector<std::string> props) {
-    auto schema = ResolveReference(node["schema"], true);
+    auto schema = ResolveReference(util::Find(node, "schema"), true);
     if (!schema) return;
-    for (auto it : props)
+    for (const auto& prop : props)
     {
-        auto value = schema[it.data()];
+        auto value = util::Find(schema, prop);
         if (value)
         {
-            node[it.data()] = value;
+            node[prop] = value;
         }
     }
 } 
 
 void Converter::CopySchemaXProperties(YAML::Node& node)
 {
-    auto schema = ResolveReference(node["schema"], true);
+    auto schema = ResolveReference(util::Find(node, "schema"), true);
     for (const auto &kv: schema) {
-        auto propName = kv.first.as<std::string>();
-        if (propName.rfind("x-", 0) == 0 && schema[propName] && !node[propName])
+        const std::string& propName = util::Text(kv.first);
+        if (propName.rfind("x-", 0) == 0 && util::Has(schema, propName) && !util::Has(node, propName))
             node[propName] = kv.second;
         }
 } 
 
 void Converter::ConvertParameters(YAML::Node& obj)
 { 
-    if (!obj["parameters"]) return;
-    auto params = obj["parameters"];
+    auto params = util::Find(obj, "parameters");
+    if (!params) return;
     for (const auto& item : params) {
-        YAML::Node param = ResolveReference(item, false);
-        
-        std::string in = param["in"].as<std::string>();
-        if (in != "body") {
-            CopySchemaProperties(param, schema_properties);
-            CopySchemaProperties(param, array_properties);
-            CopySchemaXProperties(param);
-            if (!param["description"])
-            {
-                auto schema = ResolveReference(param["schema"], false);
-                if (schema && schema["description"])
-                {
-                    param["description"] = schema["description"];
-                }
-            }
-            param.remove("schema");
-            param.remove("allowReserved");
-            if (param["example"])
+        if (util::Has(item, "$ref")) {
+            // a component parameter, converted in place the first time it is referenced
+            YAML::Node param = ResolveReference(item, false);
+            EditShared([this, param]() {
+                if (convertedParameters.insert(util::NodeView(param).Id()).second) ConvertParameter(param);
+            });
+        }
+        else {
+            ConvertParameter(item);
+        }
+    }
+}
+
+void Converter::ConvertParameter(YAML::Node param)
+{
+    std::string in = param["in"].as<std::string>();
+    if (in != "body") {
+        CopySchemaProperties(param, schema_properties);
+        CopySchemaProperties(param, array_properties);
+        CopySchemaXProperties(param);
+        if (!util::Has(param, "description"))
+        {
+            const YAML::Node schema = ResolveReference(util::Find(param, "schema"), false);
+            YAML::Node description = util::Find(schema, "description");
+            if (description)
             {
-                param["x-example"] = param["example"];
-                param.remove("example");
+                param["description"] = description;
             }
         }
-        if (param["type"] && param["type"].as<std::string>() == "array")
+        param.remove("schema");
+        param.remove("allowReserved");
+        YAML::Node example = util::Find(param, "example");
+        if (example)
         {
-            std::string style;
+            param["x-example"] = example;
+            param.remove("example");
+        }
+    }
+    YAML::Node type = util::Find(param, "type");
+    if (type && util::Text(type) == "array")
+    {
+        std::string style;
 
-            if (param["style"])
-            {
-                style = param["style"].as<std::string>();
-            } else if (in == "query" || in == "cookie")
-	        {
-                style = "form";
-	        } else
-	        {
-                style = "simple";
-	        }
-            std::string explode = param["explode"].as<std::string>();
-            if (style == "matrix") {
-                if (param["explode"]) param["collectionFormat"] = "csv";
-            }
-            else if (style == "simple") {
-                param["collectionFormat"] = "csv";
-            }
-            else if (style == "spaceDelimited") {
-                param["collectionFormat"] = "ssv";
-            }
-            else if (style == "pipeDelimited") {
-                param["collectionFormat"] = "pipes";
-            }
-            else if (style == "pipeObject") {
-                param["collectionFormat"] = "multi";
-            }
-            else if (style == "form") {
-                param["collectionFormat"] = (param["explode"].as<std::string>() == "false") ? "csv" : "multi";
-            }
+        YAML::Node styleNode = util::Find(param, "style");
+        if (styleNode)
+        {
+            style = styleNode.as<std::string>();
+        } else if (in == "query" || in == "cookie")
+        {
+            style = "form";
+        } else
+        {
+            style = "simple";
+        }
+        if (style == "matrix") {
+            if (util::Has(param, "explode")) param["collectionFormat"] = "csv";
+        }
+        else if (style == "simple") {
+            param["collectionFormat"] = "csv";
+        }
+        else if (style == "spaceDelimited") {
+            param["collectionFormat"] = "ssv";
+        }
+        else if (style == "pipeDelimited") {
+            param["collectionFormat"] = "pipes";
+        }
+        else if (style == "pipeObject") {
+            param["collectionFormat"] = "multi";
+        }
+        else if (style == "form") {
+            YAML::Node explode = util::Find(param, "explode");
+            param["collectionFormat"] = (explode && util::Text(explode) == "false") ? "csv" : "multi";
         }
-        param.remove("style");
-        param.remove("explode");
     }
+    param.remove("style");
+    param.remove("explode");
 }
 
 void Converter::ConvertSchemas() {
     input["definitions"] = input["components"]["schemas"];
 
-    for (auto it = input["definitions"].begin(); it != input["definitions"].end(); ++it) {
-        ConvertSchema(it->second, "");
+    YAML::Node definitions = input["definitions"];
+    if (options.threads == 1 || !ConvertInParallel(definitions, [this](YAML::Node& schema) { ConvertSchema(schema, "", true); })) {
+        for (auto it = definitions.begin(); it != definitions.end(); ++it) {
+            ConvertSchema(it->second, "", true);
+        }
     }
 
     input["components"].remove("schemas");
@@ -482,7 +1092,7 @@ void Converter::ConvertSecurityDefinitions() {
             auto flows = security["flows"];
             if (flows) {
                 auto flowIt = flows.begin();
-                std::string flowName = flowIt->first.as<std::string>();
+                const std::string& flowName = util::Text(flowIt->first);
                 YAML::Node flow = flowIt->second;
 
                 if (flowName == "clientCredentials") {
@@ -506,31 +1116,359 @@ void Converter::ConvertSecurityDefinitions() {
     input["components"].remove("securitySchemes");
 }
 
-std::string Converter::Convert(const std::string& source) {
-    input = YAML::LoadFile(source);;
+YAML::Node Converter::Load(const std::string& source) {
+    // one pass, unless JSON that is not strict has to be read again by yaml-cpp
+    MappedFile file;
+    if (options.mapInput && file.Open(source, MappedFile::Access::Sequential)) {
+        return Load(file.Data(), file.Size());
+    }
+
+    std::ifstream in(source, std::ios::binary);
+    if (!in.is_open()) {
+        throw YAML::BadFile(source);
+    }
+    char first = 0;
+    while (in.get(first) && std::isspace(static_cast<unsigned char>(first))) {}
+    in.clear();
+    in.seekg(0);
+    if (first == '{' || first == '[') {
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return Load(data.data(), data.size());
+    }
+    auto start = Clock::now();
+    YAML::Node document = YAML::Load(in);
+    profile.loadMs = ElapsedMs(start);
+    return document;
+}
+
+// The whole stream is needed anyway, reading it up front lets JSON skip the YAML scanner
+YAML::Node Converter::Load(std::istream& source) {
+    inputBuffer.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+    return Load(inputBuffer.data(), inputBuffer.size());
+}
+
+YAML::Node Converter::Load(const char* data, size_t size) {
+    auto start = Clock::now();
+    YAML::Node document;
+    bool parsed = false;
+    if (json::IsJson(data, size)) {
+        try {
+            document = json::Parse(data, size);
+            parsed = true;
+        }
+        catch (const json::NotStrictJson&) {
+            // not strict JSON, e.g. a YAML flow mapping with plain keys
+        }
+    }
+    if (!parsed) {
+        MemoryStreamBuf buffer(data, size);
+        std::istream stream(&buffer);
+        document = YAML::Load(stream);
+    }
+    profile.loadMs = ElapsedMs(start);
+    return document;
+}
+
+void Converter::BeginDowngrade(const YAML::Node& document, const compact::Document* compactSource) {
+    // reset instead of assign, assigning would merge every previous document into this one
+    input.reset(document);
+    source = compactSource;
+    streamData = nullptr;
+    outline = nullptr;
+    loaded.clear();
+    convertedParameters.clear();
     ConvertInfos();
+    refHits = 0;
+    refMisses = 0;
+    IndexPointers(input, "#", 3);
+}
+
+void Converter::ConvertComponents() {
+    ConvertSchemas();
+    ConvertSecurityDefinitions();
+
+    input["x-components"] = input["components"];
+    input.remove("components");
+}
+
+void Converter::EndDowngrade(double convertMs) {
+    input.reset();
+    source = nullptr;
+    streamData = nullptr;
+    outline = nullptr;
+    loaded.clear();
+    convertedParameters.clear();
+    pointers.clear();
+    profile.convertMs = convertMs;
+    profile.refHits = refHits;
+    profile.refMisses = refMisses;
+}
+
+static YAML::Node SwaggerVersion() {
+    YAML::Node version("2.0");
+    version.SetTag("!");
+    return version;
+}
+
+YAML::Node Converter::Downgrade(const YAML::Node& document) {
+    auto start = Clock::now();
+    BeginDowngrade(document, nullptr);
     ConvertOperations();
     if (input["components"]) {
-        ConvertSchemas();
-        ConvertSecurityDefinitions();
-
-        input["x-components"] = input["components"];
-        input.remove("components");
-
-        util::FixRefs(input);
-    }
-    YAML::Node result;
-    result["info"] = input["info"];
-    result["host"] = input["host"];
-    result["basePath"] = input["basePath"];
-    result["schemes"] = input["schemes"];
-    result["paths"] = input["paths"];
-    result["definitions"] = input["definitions"];
-    result["securityDefinitions"] = input["securityDefinitions"];
-    result["x-components"] = input["x-components"];
-    YAML::Emitter out;
-    out << result;
-    std::string str ="swagger: \"2.0\"\n";
-    str += out.c_str();
-    return str;
-}
\ No newline at end of file
+        ConvertComponents();
+
+        // definitions had their refs rewritten while their schemas were converted
+        for (auto it = input.begin(); it != input.end(); ++it) {
+            if (it->first.Scalar() != "definitions") {
+                YAML::Node value = it->second;
+                util::FixRefs(value, options.maxDepth);
+            }
+        }
+    }
+    // in the memory of input, so linking its entries merges nothing
+    YAML::Node result = util::NewNode(input, YAML::NodeType::Map);
+    result["swagger"] = SwaggerVersion();
+    for (const auto& key : result_keys) {
+        result[key] = input[key];
+    }
+    EndDowngrade(ElapsedMs(start));
+    return result;
+}
+
+// The path items are built as nodes, converted and written one at a time, in the order the whole
+// document is converted in. Only the rest of the document is held as nodes all along.
+void Converter::ConvertDocument(const compact::Document& document, std::ostream& out) {
+    compact::Index paths = document.Empty() ? compact::npos : document.Find(document.Root(), "paths");
+    if (paths == compact::npos || document.GetKind(paths) != compact::Kind::Map) {
+        ConvertDocument(document.Empty() ? YAML::Node() : document.ToNode(document.Root()), out);
+        return;
+    }
+
+    auto start = Clock::now();
+    BeginDowngrade(document.ToNode(document.Root(), paths), &document);
+    WritePathByPath(document.Style(paths), [&](const PathItemVisitor& visit) {
+        for (size_t i = 0; i < document.Size(paths); ++i) {
+            YAML::Node item = document.ToNode(document.Value(paths, i));
+            visit(document.ToNode(document.Key(paths, i)), item);
+        }
+    }, start, out);
+}
+
+// Reads the path items in a second pass over the input, one at a time, while the first pass kept
+// only the rest of the document
+void Converter::ConvertStreaming(const char* data, size_t size, std::ostream& out) {
+    auto start = Clock::now();
+    compact::Document rest;
+    streaming::Outline parts = streaming::ReadOutline(data, size, rest, [](const std::string& pointer) {
+        return std::find(input_pointers.begin(), input_pointers.end(), pointer) != input_pointers.end();
+    });
+    if (!parts.Streamable()) {
+        rest = compact::Document();
+        compact::Document document = compact::Load(data, size);
+        profile.loadMs = ElapsedMs(start);
+        ConvertDocument(document, out);
+        return;
+    }
+    profile.loadMs = ElapsedMs(start);
+    if (!parts.hasPaths) {
+        ConvertDocument(rest.ToNode(rest.Root()), out);
+        return;
+    }
+
+    start = Clock::now();
+    BeginDowngrade(rest.ToNode(rest.Root()), nullptr);
+    rest = compact::Document();
+    if (!parts.deferred.empty()) {
+        streamData = data;
+        outline = &parts;
+    }
+    WritePathByPath(parts.pathsStyle, [&](const PathItemVisitor& visit) {
+        streaming::ReadPathItems(data, size, parts, [&](const compact::Document& entry) {
+            compact::Index root = entry.Root();
+            YAML::Node item = entry.ToNode(entry.Value(root, 0));
+            visit(entry.ToNode(entry.Key(root, 0)), item);
+        });
+    }, start, out);
+}
+
+// Writes the document with the path items handed out by forEachPathItem, each converted on its
+// own. The rest of the document is input, set up by BeginDowngrade.
+void Converter::WritePathByPath(YAML::EmitterStyle::value pathsStyle,
+    const std::function<void(const PathItemVisitor&)>& forEachPathItem, Clock::time_point start, std::ostream& out) {
+    bool hasComponents = input["components"].IsDefined();
+
+    ResultWriter writer(out, options.format);
+    // an entry the first pass left unparsed goes from the parser to the writer, unless a $ref
+    // made the conversion parse it
+    auto writeDeferred = [&](const std::string& key, const std::string& pointer) {
+        const streaming::Deferred* part = outline ? outline->Find(pointer) : nullptr;
+        if (!part) return false;
+        auto found = loaded.find(pointer);
+        if (found != loaded.end()) {
+            YAML::Node value = found->second;
+            if (hasComponents) util::FixRefs(value, options.maxDepth);
+            writer.Member(key, value);
+            return true;
+        }
+        writer.Pipe(key, [&](YAML::EventHandler& handler) {
+            if (!hasComponents) {
+                streaming::ReadValue(streamData, *outline, *part, handler);
+                return;
+            }
+            util::FixRefsEvents fixed(handler, options.maxDepth);
+            streaming::ReadValue(streamData, *outline, *part, fixed);
+        });
+        return true;
+    };
+
+    writer.Member("swagger", SwaggerVersion());
+    for (const char* key : { "info", "host", "basePath", "schemes" }) {
+        YAML::Node value = input[key];
+        if (!value && writeDeferred(key, std::string("#/") + key)) continue;
+        if (hasComponents) util::FixRefs(value, options.maxDepth);
+        writer.Member(key, value);
+    }
+
+    writer.BeginMap("paths", pathsStyle);
+    forEachPathItem([&](const YAML::Node& key, YAML::Node& item) {
+        ConvertPathItem(item);
+        if (hasComponents) util::FixRefs(item, options.maxDepth);
+        writer.Entry(key, item);
+    });
+    writer.EndMap();
+
+    if (hasComponents) {
+        ConvertComponents();
+        for (const char* key : { "securityDefinitions", "x-components" }) {
+            YAML::Node value = input[key];
+            util::FixRefs(value, options.maxDepth);
+        }
+    }
+    for (const char* key : { "definitions", "securityDefinitions" }) {
+        writer.Member(key, input[key]);
+    }
+    if (outline && !outline->index.components.empty()) {
+        // the entries of components in their order, those left unparsed in between the others
+        YAML::Node leftover = input["x-components"];
+        writer.BeginMap("x-components", leftover ? leftover.Style() : YAML::EmitterStyle::Default);
+        for (const structural::Entry& entry : outline->index.components) {
+            if (writeDeferred(entry.key, "#/components/" + entry.key)) continue;
+            if (leftover) writer.Member(entry.key, util::Child(leftover, entry.key));
+        }
+        writer.EndMap();
+    }
+    else {
+        writer.Member("x-components", input["x-components"]);
+    }
+    writer.Finish();
+    profile.emitMs = writer.WriteMs();
+    EndDowngrade(ElapsedMs(start) - profile.emitMs);
+}
+
+// The emitter writes through to the stream as it goes, the document is never held as one string
+void Converter::Emit(const YAML::Node& result, std::ostream& out) {
+    ResultWriter writer(out, options.format, &result);
+    for (auto it = result.begin(); it != result.end(); ++it) {
+        writer.Member(it->first.Scalar(), it->second);
+    }
+    writer.Finish();
+    profile.emitMs = writer.WriteMs();
+}
+
+void Converter::Reset() {
+    input.reset();
+    source = nullptr;
+    streamData = nullptr;
+    outline = nullptr;
+    loaded.clear();
+    convertedParameters.clear();
+    pointers.clear();
+    profile = ConversionProfile();
+    inputBuffer.clear();
+    outputBuffer.clear();
+}
+
+void Converter::Convert(const std::string& source, std::ostream& out) {
+    if (options.compact || options.streaming) {
+        MappedFile file;
+        if (options.mapInput && file.Open(source)) {
+            Convert(file.Data(), file.Size(), out);
+            return;
+        }
+        std::ifstream in(source, std::ios::binary);
+        if (!in.is_open()) {
+            throw YAML::BadFile(source);
+        }
+        Convert(in, out);
+        return;
+    }
+    Emit(Downgrade(Load(source)), out);
+}
+
+void Converter::Convert(std::istream& source, std::ostream& out) {
+    if (options.compact || options.streaming) {
+        inputBuffer.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+        Convert(inputBuffer.data(), inputBuffer.size(), out);
+        return;
+    }
+    Emit(Downgrade(Load(source)), out);
+}
+
+void Converter::Convert(const char* data, size_t size, std::ostream& out) {
+    if (options.streaming) {
+        ConvertStreaming(data, size, out);
+        return;
+    }
+    if (options.compact) {
+        auto start = Clock::now();
+        compact::Document document = compact::Load(data, size);
+        profile.loadMs = ElapsedMs(start);
+        ConvertDocument(document, out);
+        return;
+    }
+    Emit(Downgrade(Load(data, size)), out);
+}
+
+void Converter::ConvertDocument(const YAML::Node& document, std::ostream& out) {
+    Emit(Downgrade(document), out);
+}
+
+std::string Converter::Convert(const std::string& source) {
+    std::ostringstream out;
+    Convert(source, out);
+    return out.str();
+}
+
+std::string Converter::Convert(std::istream& source) {
+    std::ostringstream out;
+    Convert(source, out);
+    return out.str();
+}
+
+std::string Converter::Convert(const char* data, size_t size) {
+    std::ostringstream out;
+    Convert(data, size, out);
+    return out.str();
+}
+
+std::string Converter::ConvertDocument(const YAML::Node& document) {
+    std::ostringstream out;
+    ConvertDocument(document, out);
+    return out.str();
+}
+
+YAML::Node Converter::ConvertToNode(const char* data, size_t size) {
+    return Downgrade(Load(data, size));
+}
+
+YAML::Node Converter::ConvertToNode(const YAML::Node& document) {
+    return Downgrade(document);
+}
+
+const std::string& Converter::ConvertToBuffer(const char* data, size_t size) {
+    outputBuffer.clear();
+    StringStreamBuf buffer(outputBuffer);
+    std::ostream out(&buffer);
+    Convert(data, size, out);
+    return outputBuffer;
+}
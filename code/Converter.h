@@ -1,21 +1,111 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "CompactDocument.h"
+#include "Streaming.h"
 #include "yaml-cpp/yaml.h"
 
+enum class OutputFormat {
+    Yaml,
+    Json
+};
+
+struct ConverterOptions {
+    bool mapInput = true;
+    OutputFormat format = OutputFormat::Yaml;
+    unsigned threads = 1; // path items and schemas are converted on this many threads, 0 for one per core
+    unsigned maxDepth = 2000; // deepest nesting the schema walks accept, the parsers stop at the same depth
+    bool compact = false; // parse into a compact::Document and convert the path items one at a time
+    bool streaming = false; // parse in two passes and never hold more than one path item, implies compact
+};
+
+struct ConversionProfile {
+    double loadMs = 0;
+    double convertMs = 0;
+    double emitMs = 0;
+    size_t refHits = 0;   // $refs found in the pointer index
+    size_t refMisses = 0; // $refs walked from their closest indexed ancestor, or not found
+};
+
+// Not thread-safe, use one converter per thread. It can be reused for any number of conversions.
 class Converter {
 public:
+    Converter() = default;
+    explicit Converter(const ConverterOptions& options) : options(options) {}
     std::string Convert(const std::string& source);
+    std::string Convert(std::istream& source);
+    std::string Convert(const char* data, size_t size);
+    std::string ConvertDocument(const YAML::Node& document);
+    void Convert(const std::string& source, std::ostream& out);
+    void Convert(std::istream& source, std::ostream& out);
+    void Convert(const char* data, size_t size, std::ostream& out);
+    void ConvertDocument(const YAML::Node& document, std::ostream& out);
+    // Builds yaml-cpp nodes for one path item at a time and writes it once converted
+    void ConvertDocument(const compact::Document& document, std::ostream& out);
+    // The converted Swagger 2.0 tree, for callers that keep working on it
+    YAML::Node ConvertToNode(const char* data, size_t size);
+    YAML::Node ConvertToNode(const YAML::Node& document);
+    // Output lands in a buffer owned by the converter, valid until its next conversion
+    const std::string& ConvertToBuffer(const char* data, size_t size);
+    // Forgets the last conversion, buffers keep their capacity for the next one
+    void Reset();
+    const ConverterOptions& GetOptions() const { return options; }
+    void SetOutputFormat(OutputFormat format) { options.format = format; }
+    const ConversionProfile& GetProfile() const { return profile; }
 private:
+    ConverterOptions options;
+    ConversionProfile profile;
     YAML::Node input;
+    std::string inputBuffer;
+    std::string outputBuffer;
+    // JSON pointer ("#/components/schemas/Pet") to node, for the top levels of the document
+    std::unordered_map<std::string, YAML::Node> pointers;
+    std::atomic<size_t> refHits{ 0 };
+    std::atomic<size_t> refMisses{ 0 };
+    bool parallel = false; // tasks of ConvertInParallel are running, the pointer index is read-only
+    const compact::Document* source = nullptr; // holds the path items missing from input, when converting from one
+    const char* streamData = nullptr;                   // the input of a streaming conversion
+    const streaming::Outline* outline = nullptr;        // its entries input was built without
+    std::unordered_map<std::string, YAML::Node> loaded; // those a $ref reached, by pointer
+    // Component parameters converted in place so far, however many operations refer to them
+    std::unordered_set<const void*> convertedParameters;
+    YAML::Node Load(const std::string& source);
+    YAML::Node Load(std::istream& source);
+    YAML::Node Load(const char* data, size_t size);
+    YAML::Node Downgrade(const YAML::Node& document);
+    void BeginDowngrade(const YAML::Node& document, const compact::Document* compactSource);
+    void ConvertComponents();
+    void EndDowngrade(double convertMs);
+    using PathItemVisitor = std::function<void(const YAML::Node& key, YAML::Node& item)>;
+    void WritePathByPath(YAML::EmitterStyle::value pathsStyle, const std::function<void(const PathItemVisitor&)>& forEachPathItem,
+        std::chrono::steady_clock::time_point start, std::ostream& out);
+    void ConvertStreaming(const char* data, size_t size, std::ostream& out);
+    void Emit(const YAML::Node& result, std::ostream& out);
 	void ConvertInfos();
+    void IndexPointers(const YAML::Node& node, const std::string& pointer, int depth);
+    YAML::Node LookupPointer(const std::string& ref);
+    YAML::Node LoadDeferred(const std::string& ref, std::string& pointer);
     YAML::Node ResolveReference(YAML::Node obj, bool shouldClone);
     void ConvertParameters(YAML::Node& obj);
+    void ConvertParameter(YAML::Node param);
     void ConvertOperations();
+    void ConvertPathItem(const YAML::Node& item);
+    bool ConvertInParallel(YAML::Node& map, const std::function<void(YAML::Node&)>& convert);
+    void EditShared(std::function<void()> edit);
     void CopySchemaProperties(YAML::Node& node, std::vector<std::string> props);
     void CopySchemaXProperties(YAML::Node& node);
     void ConvertOperationParameters(YAML::Node& operation);
-    void ConvertSchema(YAML::Node def, const std::string& operationDirection);
+    struct SchemaFrame;
+    void ConvertSchema(YAML::Node def, const std::string& operationDirection, bool fixRefs = false);
+    bool NextSubschema(SchemaFrame& frame, const std::string& operationDirection, YAML::Node& child);
+    void FinishSchema(SchemaFrame& frame, bool fixRefs);
     void ConvertDiscriminatorMapping(YAML::Node mapping);
     void ConvertSecurityDefinitions();
     void ConvertResponses(YAML::Node& operation);
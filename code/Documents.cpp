@@ -0,0 +1,152 @@
+#include "Documents.h"
+#include "Cache.h"
+#include "JsonParser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace documents {
+
+    namespace {
+
+        bool StartsWithMarker(const char* line, const char* end, const char* marker) {
+            if (end - line < 3 || std::memcmp(line, marker, 3) != 0) return false;
+            if (end - line == 3) return true;
+            char c = line[3];
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        // Only whitespace, comments, directives and document markers, nothing to convert
+        bool IsEmpty(const char* begin, const char* end) {
+            const char* line = begin;
+            while (line < end) {
+                const char* next = static_cast<const char*>(std::memchr(line, '\n', end - line));
+                next = next ? next + 1 : end;
+                const char* p = line;
+                if (StartsWithMarker(line, next, "---") || StartsWithMarker(line, next, "...")) p += 3;
+                else if (*p == '%') p = next;
+                while (p < next && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+                if (p < next && *p != '#') return false;
+                line = next;
+            }
+            return true;
+        }
+    }
+
+    std::vector<Range> Split(const char* data, size_t size) {
+        if (json::IsJson(data, size)) return { Range{ 0, size } };
+
+        // YAML does not allow "---" at the start of a line inside a scalar, so every such line
+        // starts a new document
+        std::vector<size_t> starts{ 0 };
+        const char* end = data + size;
+        const char* directives = nullptr;
+        for (const char* line = data; line < end;) {
+            const char* next = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            next = next ? next + 1 : end;
+            if (*line == '%') {
+                if (!directives) directives = line;
+            }
+            else {
+                if (StartsWithMarker(line, next, "---")) {
+                    size_t start = static_cast<size_t>((directives ? directives : line) - data);
+                    if (start > 0) starts.push_back(start);
+                }
+                directives = nullptr;
+            }
+            line = next;
+        }
+        starts.push_back(size);
+
+        std::vector<Range> documents;
+        for (size_t i = 0; i + 1 < starts.size(); ++i) {
+            if (IsEmpty(data + starts[i], data + starts[i + 1])) continue;
+            documents.push_back(Range{ starts[i], starts[i + 1] - starts[i] });
+        }
+        return documents;
+    }
+
+    void ConvertAll(const char* data, const std::vector<Range>& documents, const Options& options,
+        const std::function<void(size_t index, const std::string& output)>& write) {
+        size_t count = documents.size();
+        std::vector<std::string> results(count);
+        std::vector<std::string> errors(count);
+        std::vector<char> done(count, 0);
+        std::atomic<size_t> next{ 0 };
+        std::mutex mutex;
+        std::condition_variable ready;
+
+        unsigned workerCount = options.jobs ? options.jobs : std::thread::hardware_concurrency();
+        workerCount = std::max(1u, std::min(workerCount, static_cast<unsigned>(count)));
+        std::vector<std::thread> workers;
+        for (unsigned w = 0; w < workerCount; ++w) {
+            workers.emplace_back([&]() {
+                Converter converter(options.converter);
+                size_t i;
+                while ((i = next++) < count) {
+                    std::ostringstream out;
+                    std::string error;
+                    try {
+                        const char* document = data + documents[i].offset;
+                        if (options.cache) {
+                            options.cache->Convert(converter, document, documents[i].size, out);
+                        }
+                        else {
+                            converter.Convert(document, documents[i].size, out);
+                        }
+                    }
+                    catch (const std::exception& err) {
+                        error = err.what();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        results[i] = out.str();
+                        errors[i] = error;
+                        done[i] = 1;
+                    }
+                    ready.notify_all();
+                }
+            });
+        }
+
+        // Results are written as soon as all earlier documents are out, then released
+        size_t failed = count;
+        std::exception_ptr writeError;
+        for (size_t i = 0; i < count; ++i) {
+            std::string output;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return done[i] != 0; });
+                output.swap(results[i]);
+            }
+            if (!errors[i].empty()) {
+                failed = i;
+                break;
+            }
+            try {
+                write(i, output);
+            }
+            catch (...) {
+                writeError = std::current_exception();
+                break;
+            }
+        }
+        next = count;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (writeError) {
+            std::rethrow_exception(writeError);
+        }
+        if (failed != count) {
+            throw std::runtime_error("Document " + std::to_string(failed + 1) + ": " + errors[failed]);
+        }
+    }
+}
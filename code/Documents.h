@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Converter.h"
+
+class Cache;
+
+namespace documents {
+
+    struct Range {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    // Byte ranges of the documents in a YAML stream, split at "---" lines so each one can be
+    // parsed on its own. Directives go with the document they precede, and ranges holding
+    // nothing but comments or markers are dropped. JSON input is always one document.
+    std::vector<Range> Split(const char* data, size_t size);
+
+    struct Options {
+        ConverterOptions converter;
+        unsigned jobs = 0;
+        Cache* cache = nullptr;
+    };
+
+    // Converts every document on a pool of workers, each with its own Converter, and hands the
+    // results to write in document order as they become available.
+    // Throws naming the first document that failed.
+    void ConvertAll(const char* data, const std::vector<Range>& documents, const Options& options,
+        const std::function<void(size_t index, const std::string& output)>& write);
+}
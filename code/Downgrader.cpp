@@ -0,0 +1,52 @@
+#include "Downgrader.h"
+#include "Converter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+
+namespace {
+
+    // The result is copied out, callers may free it from another thread (goroutines move)
+    int Fill(out_buf* out, const std::string& data, int status) {
+        out->size = data.size();
+        out->data = static_cast<char*>(std::malloc(data.size() + 1));
+        if (!out->data) {
+            out->size = 0;
+            return -1;
+        }
+        std::memcpy(out->data, data.data(), data.size());
+        out->data[data.size()] = '\0';
+        return status;
+    }
+}
+
+extern "C" DOWNGRADER_API int downgrade(const char* spec, size_t size, out_buf* out) {
+    return downgrade_format(spec, size, DOWNGRADE_YAML, out);
+}
+
+extern "C" DOWNGRADER_API int downgrade_format(const char* spec, size_t size, int format, out_buf* out) {
+    if (!out) return -1;
+    out->data = nullptr;
+    out->size = 0;
+    if (!spec && size > 0) return Fill(out, "spec is null", 1);
+
+    // One converter per calling thread, so its buffers are reused across calls
+    thread_local Converter converter;
+    try {
+        converter.SetOutputFormat(format == DOWNGRADE_JSON ? OutputFormat::Json : OutputFormat::Yaml);
+        return Fill(out, converter.ConvertToBuffer(spec, size), 0);
+    }
+    catch (const std::exception& err) {
+        converter.Reset();
+        return Fill(out, err.what(), 1);
+    }
+}
+
+extern "C" DOWNGRADER_API void downgrade_free(out_buf* out) {
+    if (!out) return;
+    std::free(out->data);
+    out->data = nullptr;
+    out->size = 0;
+}
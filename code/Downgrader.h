@@ -0,0 +1,42 @@
+#pragma once
+/* C interface for embedding the converter through FFI. Safe to call from any number of
+   threads at once, every calling thread keeps its own warm converter. */
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifdef DOWNGRADER_EXPORTS
+#define DOWNGRADER_API __declspec(dllexport)
+#else
+#define DOWNGRADER_API __declspec(dllimport)
+#endif
+#else
+#define DOWNGRADER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct out_buf {
+    char* data;
+    size_t size;
+} out_buf;
+
+enum downgrade_format {
+    DOWNGRADE_YAML = 0,
+    DOWNGRADE_JSON = 1
+};
+
+/* Converts an OpenAPI 3 spec (YAML or JSON) to a Swagger 2.0 YAML document.
+   Returns 0 on success. Otherwise out holds the error message. Either way out
+   must be released with downgrade_free. */
+DOWNGRADER_API int downgrade(const char* spec, size_t size, out_buf* out);
+
+/* Same as downgrade with a choice of output format */
+DOWNGRADER_API int downgrade_format(const char* spec, size_t size, int format, out_buf* out);
+
+DOWNGRADER_API void downgrade_free(out_buf* out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,474 @@
+#include "JsonParser.h"
+#include "Util.h"
+
+#include <cstdint>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace json {
+
+    namespace {
+
+        const int max_depth = 2000;
+
+        inline bool IsWhitespace(char c) {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        inline bool IsDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        const char* SkipBom(const char* p, const char* end) {
+            if (end - p >= 3 && p[0] == '\xEF' && p[1] == '\xBB' && p[2] == '\xBF') return p + 3;
+            return p;
+        }
+
+#ifdef JSON_USE_SSE2
+        inline int LowestBit(int mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, static_cast<unsigned long>(mask));
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+        }
+#endif
+
+        // First '"' or '\\' at or after p, 16 bytes at a time where SSE2 is available.
+        // Long descriptions and $ref strings make up most of a spec's bytes.
+        const char* FindStringEnd(const char* p, const char* end) {
+#ifdef JSON_USE_SSE2
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            while (end - p >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+                if (mask) return p + LowestBit(mask);
+                p += 16;
+            }
+#endif
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            return p;
+        }
+
+        void AppendUtf8(std::string& out, uint32_t cp) {
+            if (cp < 0x80) {
+                out += static_cast<char>(cp);
+            }
+            else if (cp < 0x800) {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000) {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        // The lexical part shared by both parsers
+        class Scanner {
+        protected:
+            Scanner(const char* data, size_t size) : begin(data), cur(data), end(data + size) {}
+
+            // Unlike YAML::DepthGuard this does not build a Mark unless the limit is hit
+            struct Nesting {
+                explicit Nesting(Scanner& scanner) : scanner(scanner) {
+                    if (++scanner.depth >= max_depth) scanner.Fail("document is nested too deeply");
+                }
+                ~Nesting() { --scanner.depth; }
+                Scanner& scanner;
+            };
+
+            // Unescapes the string at cur into text
+            void ScanString() {
+                ++cur;
+                text.clear();
+                for (;;) {
+                    const char* stop = FindStringEnd(cur, end);
+                    text.append(cur, stop);
+                    cur = stop;
+                    if (cur == end) Fail("unterminated string");
+                    if (*cur++ == '"') break;
+                    ParseEscape();
+                }
+            }
+
+            void ParseEscape() {
+                if (cur == end) Fail("unterminated string");
+                switch (*cur++) {
+                case '"': text += '"'; break;
+                case '\\': text += '\\'; break;
+                case '/': text += '/'; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u': {
+                    uint32_t cp = ParseHex4();
+                    if (cp >= 0xD800 && cp <= 0xDBFF && end - cur >= 2 && cur[0] == '\\' && cur[1] == 'u') {
+                        cur += 2;
+                        uint32_t low = ParseHex4();
+                        if (low < 0xDC00 || low > 0xDFFF) Fail("invalid surrogate pair");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(text, cp);
+                    break;
+                }
+                default:
+                    --cur;
+                    NotStrict("invalid escape sequence");
+                }
+            }
+
+            uint32_t ParseHex4() {
+                if (end - cur < 4) Fail("invalid unicode escape");
+                uint32_t cp = 0;
+                for (int i = 0; i < 4; ++i, ++cur) {
+                    char c = *cur;
+                    cp <<= 4;
+                    if (IsDigit(c)) cp |= c - '0';
+                    else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+                    else Fail("invalid unicode escape");
+                }
+                return cp;
+            }
+
+            // Numbers keep their source text, like any other plain scalar
+            std::string ParseNumber() {
+                const char* start = cur;
+                if (*cur == '-') ++cur;
+                if (cur < end && *cur == '0') {
+                    ++cur;
+                }
+                else if (cur < end && IsDigit(*cur)) {
+                    while (cur < end && IsDigit(*cur)) ++cur;
+                }
+                else {
+                    NotStrict("invalid number");
+                }
+                if (cur < end && *cur == '.') {
+                    ++cur;
+                    if (cur == end || !IsDigit(*cur)) NotStrict("invalid number");
+                    while (cur < end && IsDigit(*cur)) ++cur;
+                }
+                if (cur < end && (*cur == 'e' || *cur == 'E')) {
+                    ++cur;
+                    if (cur < end && (*cur == '+' || *cur == '-')) ++cur;
+                    if (cur == end || !IsDigit(*cur)) NotStrict("invalid number");
+                    while (cur < end && IsDigit(*cur)) ++cur;
+                }
+                return std::string(start, cur);
+            }
+
+            bool Literal(const char* literal) {
+                size_t length = std::char_traits<char>::length(literal);
+                if (static_cast<size_t>(end - cur) < length || std::char_traits<char>::compare(cur, literal, length) != 0) return false;
+                cur += length;
+                return true;
+            }
+
+            void SkipWhitespace() {
+                while (cur < end && IsWhitespace(*cur)) ++cur;
+            }
+
+            char Peek() const {
+                return cur < end ? *cur : '\0';
+            }
+
+            bool Consume(char c) {
+                if (cur < end && *cur == c) {
+                    ++cur;
+                    return true;
+                }
+                return false;
+            }
+
+            void Expect(char c) {
+                if (Consume(c)) return;
+                std::string message = std::string("expected '") + c + "'";
+                if (Peek() == '#') NotStrict(message); // a comment
+                Fail(message);
+            }
+
+            // Line and column are only needed for errors, so they are counted on demand
+            YAML::Mark Position() const {
+                YAML::Mark mark;
+                mark.pos = static_cast<int>(cur - begin);
+                for (const char* p = begin; p < cur; ++p) {
+                    if (*p == '\n') {
+                        ++mark.line;
+                        mark.column = 0;
+                    }
+                    else {
+                        ++mark.column;
+                    }
+                }
+                return mark;
+            }
+
+            [[noreturn]] void Fail(const std::string& message) const {
+                throw YAML::ParserException(Position(), message);
+            }
+
+            // Not JSON here, but maybe YAML
+            [[noreturn]] void NotStrict(const std::string& message) const {
+                throw NotStrictJson(Position(), message);
+            }
+
+            const char* begin;
+            const char* cur;
+            const char* end;
+            int depth = 0;
+            std::string text;
+        };
+
+        // Recursive descent over the buffer. Every node is made in the memory of the root, so
+        // attaching it to its parent merges no memories.
+        // Scalars are tagged the way yaml-cpp tags them: "!" for strings, "?" for plain values.
+        class Parser : public Scanner {
+        public:
+            Parser(const char* data, size_t size) : Scanner(data, size) {}
+
+            YAML::Node ParseDocument() {
+                cur = SkipBom(cur, end);
+                SkipWhitespace();
+                if (Peek() == '{') {
+                    root = Container(YAML::NodeType::Map);
+                    ParseObject(root);
+                }
+                else if (Peek() == '[') {
+                    root = Container(YAML::NodeType::Sequence);
+                    ParseArray(root);
+                }
+                else {
+                    Fail("expected an object or an array");
+                }
+                SkipWhitespace();
+                if (cur != end) NotStrict("unexpected content after the document");
+                return root;
+            }
+
+        private:
+            void ParseObject(YAML::Node& node) {
+                Nesting nesting(*this);
+                ++cur;
+                SkipWhitespace();
+                if (Consume('}')) return;
+                do {
+                    SkipWhitespace();
+                    if (Peek() != '"') NotStrict("expected a string key");
+                    YAML::Node key = ParseString();
+                    SkipWhitespace();
+                    Expect(':');
+                    SkipWhitespace();
+                    if (Peek() == '{') {
+                        YAML::Node child = Container(YAML::NodeType::Map);
+                        node.force_insert(key, child);
+                        ParseObject(child);
+                    }
+                    else if (Peek() == '[') {
+                        YAML::Node child = Container(YAML::NodeType::Sequence);
+                        node.force_insert(key, child);
+                        ParseArray(child);
+                    }
+                    else {
+                        node.force_insert(key, ParseScalar());
+                    }
+                    SkipWhitespace();
+                } while (Consume(','));
+                Expect('}');
+            }
+
+            void ParseArray(YAML::Node& node) {
+                Nesting nesting(*this);
+                ++cur;
+                SkipWhitespace();
+                if (Consume(']')) return;
+                do {
+                    SkipWhitespace();
+                    if (Peek() == '{') {
+                        YAML::Node child = Container(YAML::NodeType::Map);
+                        node.push_back(child);
+                        ParseObject(child);
+                    }
+                    else if (Peek() == '[') {
+                        YAML::Node child = Container(YAML::NodeType::Sequence);
+                        node.push_back(child);
+                        ParseArray(child);
+                    }
+                    else {
+                        node.push_back(ParseScalar());
+                    }
+                    SkipWhitespace();
+                } while (Consume(','));
+                Expect(']');
+            }
+
+            YAML::Node ParseScalar() {
+                char c = Peek();
+                if (c == '"') return ParseString();
+                if (c == '-' || IsDigit(c)) return Plain(ParseNumber());
+                if (Literal("true")) return Plain("true");
+                if (Literal("false")) return Plain("false");
+                if (Literal("null")) return util::NewNode(root, YAML::NodeType::Null);
+                NotStrict("unexpected character");
+                return YAML::Node();
+            }
+
+            YAML::Node ParseString() {
+                ScanString();
+                YAML::Node node = util::NewNode(root, text);
+                node.SetTag("!");
+                return node;
+            }
+
+            // yaml-cpp marks flow collections, so they are emitted in flow style again
+            YAML::Node Container(YAML::NodeType::value type) {
+                YAML::Node node = util::NewNode(root, type);
+                node.SetStyle(YAML::EmitterStyle::Flow);
+                return node;
+            }
+
+            YAML::Node Plain(const std::string& value) {
+                YAML::Node node = util::NewNode(root, value);
+                node.SetTag("?");
+                return node;
+            }
+
+            YAML::Node root; // set first, with a memory of its own
+        };
+
+        // The same grammar reported as the events YAML::Parser produces for a JSON document
+        class EventParser : public Scanner {
+        public:
+            EventParser(const char* data, size_t size, YAML::EventHandler& handler, size_t offset = 0)
+                : Scanner(data, size), handler(handler), offset(offset) {}
+
+            void ParseDocument() {
+                cur = SkipBom(cur, end);
+                SkipWhitespace();
+                if (Peek() != '{' && Peek() != '[') Fail("expected an object or an array");
+                handler.OnDocumentStart(YAML::Mark());
+                ParseValue();
+                SkipWhitespace();
+                if (cur != end) NotStrict("unexpected content after the document");
+                handler.OnDocumentEnd();
+            }
+
+            // A single value of any kind, without the document events around it
+            void ParseFragment() {
+                SkipWhitespace();
+                ParseValue();
+                SkipWhitespace();
+                if (cur != end) Fail("unexpected content after the value");
+            }
+
+        private:
+            void ParseValue() {
+                char c = Peek();
+                if (c == '{') ParseObject();
+                else if (c == '[') ParseArray();
+                else if (c == '"') ParseString("!");
+                else if (c == '-' || IsDigit(c)) {
+                    YAML::Mark mark = Start();
+                    handler.OnScalar(mark, "?", YAML::NullAnchor, ParseNumber());
+                }
+                else if (Literal("true")) handler.OnScalar(Start(-4), "?", YAML::NullAnchor, "true");
+                else if (Literal("false")) handler.OnScalar(Start(-5), "?", YAML::NullAnchor, "false");
+                else if (Literal("null")) handler.OnNull(YAML::Mark(), YAML::NullAnchor);
+                else NotStrict("unexpected character");
+            }
+
+            void ParseObject() {
+                Nesting nesting(*this);
+                ++cur;
+                handler.OnMapStart(YAML::Mark(), "?", YAML::NullAnchor, YAML::EmitterStyle::Flow);
+                SkipWhitespace();
+                if (!Consume('}')) {
+                    do {
+                        SkipWhitespace();
+                        if (Peek() != '"') NotStrict("expected a string key");
+                        ParseString("!");
+                        SkipWhitespace();
+                        Expect(':');
+                        SkipWhitespace();
+                        ParseValue();
+                        SkipWhitespace();
+                    } while (Consume(','));
+                    Expect('}');
+                }
+                handler.OnMapEnd();
+            }
+
+            void ParseArray() {
+                Nesting nesting(*this);
+                ++cur;
+                handler.OnSequenceStart(YAML::Mark(), "?", YAML::NullAnchor, YAML::EmitterStyle::Flow);
+                SkipWhitespace();
+                if (!Consume(']')) {
+                    do {
+                        SkipWhitespace();
+                        ParseValue();
+                        SkipWhitespace();
+                    } while (Consume(','));
+                    Expect(']');
+                }
+                handler.OnSequenceEnd();
+            }
+
+            void ParseString(const char* tag) {
+                YAML::Mark mark = Start();
+                ScanString();
+                handler.OnScalar(mark, tag, YAML::NullAnchor, text);
+            }
+
+            // Where a scalar starts, so a builder can keep it as a range of the input. Only the
+            // offset: line and column would cost a count over everything before it.
+            YAML::Mark Start(int back = 0) const {
+                YAML::Mark mark;
+                mark.pos = static_cast<int>(offset + (cur - begin) + back);
+                return mark;
+            }
+
+            YAML::EventHandler& handler;
+            size_t offset; // of data in the document it was cut from
+        };
+    }
+
+    bool IsJson(const char* data, size_t size) {
+        const char* end = data + size;
+        const char* p = SkipBom(data, end);
+        while (p < end && IsWhitespace(*p)) ++p;
+        return p < end && (*p == '{' || *p == '[');
+    }
+
+    YAML::Node Parse(const char* data, size_t size) {
+        return Parser(data, size).ParseDocument();
+    }
+
+    void Parse(const char* data, size_t size, YAML::EventHandler& handler) {
+        EventParser(data, size, handler).ParseDocument();
+    }
+
+    void ParseValue(const char* data, size_t size, YAML::EventHandler& handler, size_t offset) {
+        EventParser(data, size, handler, offset).ParseFragment();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include "yaml-cpp/eventhandler.h"
+#include "yaml-cpp/yaml.h"
+
+namespace json {
+
+    // True when the first byte after whitespace (and a UTF-8 BOM) opens a JSON object or array
+    bool IsJson(const char* data, size_t size);
+
+    // Thrown where the input stops being strict JSON in a way YAML may still read, at an unquoted
+    // key or value, a comment or a second document. Callers can fall back to the YAML parser on
+    // this one. Any other YAML::ParserException is an error whichever parser reads the input.
+    class NotStrictJson : public YAML::ParserException {
+    public:
+        NotStrictJson(const YAML::Mark& mark, const std::string& message) : YAML::ParserException(mark, message) {}
+    };
+
+    // Builds the same tree YAML::Load produces for a JSON document, without going through the
+    // YAML scanner. Throws NotStrictJson or another YAML::ParserException on malformed input.
+    YAML::Node Parse(const char* data, size_t size);
+
+    // Reports the document to handler as the events YAML::Parser would produce for it, without
+    // building nodes. The mark of a scalar holds its byte offset, or that of its opening quote,
+    // line and column are left 0. Throws YAML::ParserException on malformed input, possibly
+    // after some events.
+    void Parse(const char* data, size_t size, YAML::EventHandler& handler);
+
+    // The events of one value cut out of a document, a string, number or literal as well as an
+    // object or array. No document events are reported around them. offset is where data starts
+    // in the document, the marks of scalars count from there.
+    void ParseValue(const char* data, size_t size, YAML::EventHandler& handler, size_t offset = 0);
+}
@@ -0,0 +1,374 @@
+#include "JsonWriter.h"
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "yaml-cpp/emitfromevents.h"
+
+namespace json {
+
+    namespace {
+
+        const size_t flush_threshold = 1 << 16;
+        const int max_depth = 2000;
+
+        struct EscapeTable {
+            EscapeTable() {
+                for (int c = 0; c < 0x20; ++c) escape[c] = true;
+                escape[static_cast<unsigned char>('"')] = true;
+                escape[static_cast<unsigned char>('\\')] = true;
+            }
+            bool escape[256] = {};
+        };
+        const EscapeTable escape_table;
+
+        bool IsDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        // Same grammar the parser accepts, anything else is written as a string
+        bool IsNumber(const std::string& value) {
+            const char* p = value.c_str();
+            if (*p == '-') ++p;
+            if (*p == '0') {
+                ++p;
+            }
+            else if (IsDigit(*p)) {
+                while (IsDigit(*p)) ++p;
+            }
+            else {
+                return false;
+            }
+            if (*p == '.') {
+                ++p;
+                if (!IsDigit(*p)) return false;
+                while (IsDigit(*p)) ++p;
+            }
+            if (*p == 'e' || *p == 'E') {
+                ++p;
+                if (*p == '+' || *p == '-') ++p;
+                if (!IsDigit(*p)) return false;
+                while (IsDigit(*p)) ++p;
+            }
+            return p == value.c_str() + value.size();
+        }
+
+        bool IsTrue(const std::string& value) {
+            return value == "true" || value == "True" || value == "TRUE";
+        }
+
+        bool IsFalse(const std::string& value) {
+            return value == "false" || value == "False" || value == "FALSE";
+        }
+    }
+
+    Writer::Writer(std::ostream& out) : out(out) {
+        buffer.reserve(flush_threshold + 4096);
+    }
+
+    Writer::~Writer() {
+        Flush();
+    }
+
+    void Writer::BeginObject() {
+        Put('{');
+        first = true;
+        ++depth;
+    }
+
+    void Writer::BeginObject(const std::string& key) {
+        Key(key);
+        BeginObject();
+    }
+
+    void Writer::Member(const std::string& key, const std::string& value) {
+        Key(key);
+        String(value);
+    }
+
+    void Writer::Member(const std::string& key, const YAML::Node& value) {
+        if (!value.IsDefined()) return;
+        Key(key);
+        Value(value, depth);
+    }
+
+    // Follows the containers the events open, a complex key is written by the YAML emitter the
+    // way Value writes it with YAML::Dump
+    class Writer::Events : public YAML::EventHandler {
+    public:
+        Events(Writer& writer, int depth) : writer(writer), depth(depth) {}
+
+        void OnDocumentStart(const YAML::Mark&) override {}
+        void OnDocumentEnd() override {}
+
+        void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+            if (Capturing()) {
+                key->events.OnNull(mark, anchor);
+                if (key->depth == 0) WriteKey();
+                return;
+            }
+            Begin();
+            writer.Put("null", 4);
+            Complete();
+        }
+
+        void OnAlias(const YAML::Mark&, YAML::anchor_t) override {
+            throw std::runtime_error("Aliases cannot be written from events");
+        }
+
+        void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override {
+            if (key) {
+                key->events.OnScalar(mark, tag, anchor, value);
+                return;
+            }
+            if (AtKey()) {
+                NextEntry();
+                writer.String(value);
+                writer.Put(": ", 2);
+                frames.back().key = false;
+                return;
+            }
+            Begin();
+            writer.Scalar(tag, value);
+            Complete();
+        }
+
+        void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+            if (Capturing()) {
+                ++key->depth;
+                key->events.OnSequenceStart(mark, tag, anchor, style);
+                return;
+            }
+            Open(false);
+        }
+
+        void OnSequenceEnd() override {
+            if (key) {
+                key->events.OnSequenceEnd();
+                if (--key->depth == 0) WriteKey();
+                return;
+            }
+            Close(']');
+        }
+
+        void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+            if (Capturing()) {
+                ++key->depth;
+                key->events.OnMapStart(mark, tag, anchor, style);
+                return;
+            }
+            Open(true);
+        }
+
+        void OnMapEnd() override {
+            if (key) {
+                key->events.OnMapEnd();
+                if (--key->depth == 0) WriteKey();
+                return;
+            }
+            Close('}');
+        }
+
+    private:
+        struct Frame {
+            bool map;
+            bool empty;
+            bool key; // the next node of the map is a key
+            int depth;
+        };
+
+        struct Key {
+            YAML::Emitter emitter;
+            YAML::EmitFromEvents events{ emitter };
+            int depth = 0;
+        };
+
+        bool AtKey() const {
+            return !frames.empty() && frames.back().map && frames.back().key;
+        }
+
+        // Starts capturing a key that is not a scalar, true while one is captured
+        bool Capturing() {
+            if (!key && AtKey()) key.reset(new Key());
+            return key != nullptr;
+        }
+
+        void NextEntry() {
+            Frame& frame = frames.back();
+            if (!frame.empty) writer.Put(',');
+            frame.empty = false;
+            writer.NewLine(frame.depth + 1);
+        }
+
+        void WriteKey() {
+            NextEntry();
+            writer.String(key->emitter.c_str());
+            writer.Put(": ", 2);
+            frames.back().key = false;
+            key.reset();
+        }
+
+        // Before a value, gives its depth
+        int Begin() {
+            int valueDepth = frames.empty() ? depth : frames.back().depth + 1;
+            if (valueDepth > max_depth) {
+                throw std::runtime_error("Document is nested too deeply to write as JSON");
+            }
+            if (!frames.empty() && !frames.back().map) NextEntry();
+            return valueDepth;
+        }
+
+        void Complete() {
+            if (!frames.empty() && frames.back().map) frames.back().key = true;
+        }
+
+        void Open(bool map) {
+            int valueDepth = Begin();
+            writer.Put(map ? '{' : '[');
+            frames.push_back(Frame{ map, true, true, valueDepth });
+        }
+
+        void Close(char bracket) {
+            Frame frame = frames.back();
+            frames.pop_back();
+            if (!frame.empty) writer.NewLine(frame.depth);
+            writer.Put(bracket);
+            Complete();
+        }
+
+        Writer& writer;
+        int depth;
+        std::vector<Frame> frames;
+        std::unique_ptr<Key> key; // being captured
+    };
+
+    void Writer::Member(const std::string& key, const std::function<void(YAML::EventHandler& handler)>& report) {
+        Key(key);
+        Events events(*this, depth);
+        report(events);
+    }
+
+    void Writer::EndObject() {
+        --depth;
+        if (!first) NewLine(depth);
+        Put('}');
+        first = false;
+        if (depth == 0) Put('\n');
+    }
+
+    void Writer::Flush() {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+    void Writer::Key(const std::string& key) {
+        if (!first) Put(',');
+        first = false;
+        NewLine(depth);
+        String(key);
+        Put(": ", 2);
+    }
+
+    void Writer::Value(const YAML::Node& node, int depth) {
+        if (depth > max_depth) {
+            throw std::runtime_error("Document is nested too deeply to write as JSON");
+        }
+        switch (node.Type()) {
+        case YAML::NodeType::Map: {
+            Put('{');
+            bool empty = true;
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                if (!empty) Put(',');
+                empty = false;
+                NewLine(depth + 1);
+                String(it->first.IsScalar() ? it->first.Scalar() : YAML::Dump(it->first));
+                Put(": ", 2);
+                Value(it->second, depth + 1);
+            }
+            if (!empty) NewLine(depth);
+            Put('}');
+            break;
+        }
+        case YAML::NodeType::Sequence: {
+            Put('[');
+            bool empty = true;
+            for (auto it = node.begin(); it != node.end(); ++it) {
+                if (!empty) Put(',');
+                empty = false;
+                NewLine(depth + 1);
+                Value(*it, depth + 1);
+            }
+            if (!empty) NewLine(depth);
+            Put(']');
+            break;
+        }
+        case YAML::NodeType::Scalar:
+            Scalar(node.Tag(), node.Scalar());
+            break;
+        default:
+            Put("null", 4);
+            break;
+        }
+    }
+
+    void Writer::Scalar(const std::string& tag, const std::string& value) {
+        if (tag == "!" || tag == "tag:yaml.org,2002:str") {
+            String(value);
+        }
+        else if (IsNumber(value)) {
+            Put(value.data(), value.size());
+        }
+        else if (IsTrue(value)) {
+            Put("true", 4);
+        }
+        else if (IsFalse(value)) {
+            Put("false", 5);
+        }
+        else {
+            String(value);
+        }
+    }
+
+    // Runs of characters that need no escaping are copied in one go
+    void Writer::String(const std::string& value) {
+        static const char hex[] = "0123456789abcdef";
+        Put('"');
+        const char* p = value.data();
+        const char* end = p + value.size();
+        while (p < end) {
+            const char* run = p;
+            while (p < end && !escape_table.escape[static_cast<unsigned char>(*p)]) ++p;
+            Put(run, static_cast<size_t>(p - run));
+            if (p == end) break;
+            char c = *p++;
+            switch (c) {
+            case '"': Put("\\\"", 2); break;
+            case '\\': Put("\\\\", 2); break;
+            case '\n': Put("\\n", 2); break;
+            case '\r': Put("\\r", 2); break;
+            case '\t': Put("\\t", 2); break;
+            case '\b': Put("\\b", 2); break;
+            case '\f': Put("\\f", 2); break;
+            default: {
+                char escaped[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xF], hex[c & 0xF] };
+                Put(escaped, sizeof(escaped));
+            }
+            }
+        }
+        Put('"');
+    }
+
+    void Writer::NewLine(int depth) {
+        Put('\n');
+        buffer.append(static_cast<size_t>(depth) * 2, ' ');
+    }
+
+    void Writer::Put(char c) {
+        buffer += c;
+    }
+
+    void Writer::Put(const char* data, size_t size) {
+        buffer.append(data, size);
+        if (buffer.size() >= flush_threshold) Flush();
+    }
+}
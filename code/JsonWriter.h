@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <ostream>
+#include <string>
+#include "yaml-cpp/eventhandler.h"
+#include "yaml-cpp/yaml.h"
+
+namespace json {
+
+    // Writes a YAML tree as indented JSON through its own buffer, without YAML::Emitter.
+    // Scalars quoted in the source stay strings, plain ones become numbers, booleans or null
+    // when they read as such.
+    class Writer {
+    public:
+        explicit Writer(std::ostream& out);
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void BeginObject();
+        // An object member that is written one member at a time, closed by EndObject
+        void BeginObject(const std::string& key);
+        void Member(const std::string& key, const std::string& value);
+        void Member(const std::string& key, const YAML::Node& value);
+        // A member whose value report gives as parser events, written as Member writes the node
+        // YAML::Load would build from them
+        void Member(const std::string& key, const std::function<void(YAML::EventHandler& handler)>& report);
+        void EndObject();
+        void Flush();
+
+    private:
+        class Events;
+
+        void Key(const std::string& key);
+        void Value(const YAML::Node& node, int depth);
+        void Scalar(const std::string& tag, const std::string& value);
+        void String(const std::string& value);
+        void NewLine(int depth);
+        void Put(char c);
+        void Put(const char* data, size_t size);
+
+        std::ostream& out;
+        std::string buffer;
+        bool first = true;
+        int depth = 0; // of the objects begun and not yet ended
+    };
+}
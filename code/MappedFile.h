@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // How the mapping will be read. Sequential is for a single pass from front to back, anything
+    // that reads the bytes again or jumps around them is Repeated.
+    enum class Access { Sequential, Repeated };
+
+    bool Open(const std::string& path, Access access = Access::Repeated);
+    void Close();
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+// Read-only stream buffer over memory owned by someone else, no copy is made.
+class MemoryStreamBuf : public std::streambuf {
+public:
+    MemoryStreamBuf(const char* data, size_t size);
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
@@ -0,0 +1,86 @@
+#include "NodeView.h"
+
+namespace util {
+
+    namespace {
+
+        // YAML::Node() is a null node of no document yet, it only gets one when it is changed
+        const YAML::detail::node* NullNode() {
+            static const YAML::Node null(YAML::NodeType::Null);
+            return null.GetNode();
+        }
+
+        const YAML::detail::node* Viewed(const YAML::Node& node) {
+            if (!node.IsValid()) return nullptr;
+            return node.GetNode() ? node.GetNode() : NullNode();
+        }
+    }
+
+    NodeView::NodeView(const YAML::Node& node) : node(Viewed(node)) {}
+
+    const std::string& NodeView::Scalar() const {
+        static const std::string empty;
+        return IsScalar() ? node->scalar() : empty;
+    }
+
+    const std::string& NodeView::Tag() const {
+        static const std::string empty;
+        return IsDefined() ? node->tag() : empty;
+    }
+
+    YAML::Mark NodeView::Mark() const {
+        return node ? node->mark() : YAML::Mark::null_mark();
+    }
+
+    NodeView NodeView::operator[](const std::string& key) const {
+        switch (Type()) {
+        case YAML::NodeType::Map:
+            break;
+        case YAML::NodeType::Scalar:
+            throw YAML::BadSubscript(Mark(), key);
+        default:
+            return NodeView();
+        }
+        for (auto it = node->begin(); it != node->end(); ++it) {
+            const YAML::detail::node* k = it->first;
+            if (k->type() == YAML::NodeType::Scalar && k->scalar() == key) return NodeView(it->second);
+        }
+        return NodeView();
+    }
+
+    NodeView NodeView::operator[](size_t index) const {
+        if (!IsSequence()) return NodeView();
+        // the memory is only used to grow a sequence, a const lookup does without
+        return NodeView(node->get(index, YAML::detail::shared_memory_holder()));
+    }
+
+    NodeView::const_iterator NodeView::begin() const {
+        return IsDefined() ? const_iterator(node->begin()) : const_iterator();
+    }
+
+    NodeView::const_iterator NodeView::end() const {
+        return IsDefined() ? const_iterator(node->end()) : const_iterator();
+    }
+
+    YAML::Node NodeView::Bind(const YAML::Node& document) const {
+        if (!node) {
+            static const YAML::Node missing = static_cast<const YAML::Node&>(YAML::Node(YAML::NodeType::Map))[""];
+            return missing;
+        }
+        if (node == NullNode()) return YAML::Node();
+        return YAML::Node(const_cast<YAML::detail::node&>(*node), document.GetMemory());
+    }
+
+    NodeView::Item NodeView::const_iterator::operator*() const {
+        YAML::detail::node_iterator_value<const YAML::detail::node> value = *it;
+        Item item;
+        if (value.pNode) {
+            static_cast<NodeView&>(item) = NodeView(value.pNode);
+        }
+        else {
+            item.first = NodeView(value.first);
+            item.second = NodeView(value.second);
+        }
+        return item;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <string>
+#include "yaml-cpp/yaml.h"
+
+namespace util {
+
+    // A read-only handle on a node of a document someone else keeps alive. YAML::Node holds a
+    // reference on the memory of its document, so every copy, iterator step and lookup result
+    // updates an atomic count; a view is a plain pointer. It must not outlive the document, and
+    // reads only: Bind hands out a YAML::Node again for whatever is to be changed or kept.
+    class NodeView {
+    public:
+        struct Item;
+        class const_iterator;
+
+        NodeView() = default; // missing, like the result of a lookup that found nothing
+        NodeView(const YAML::Node& node);
+
+        YAML::NodeType::value Type() const { return node ? node->type() : YAML::NodeType::Undefined; }
+        bool IsDefined() const { return node && node->is_defined(); }
+        bool IsNull() const { return Type() == YAML::NodeType::Null; }
+        bool IsScalar() const { return Type() == YAML::NodeType::Scalar; }
+        bool IsSequence() const { return Type() == YAML::NodeType::Sequence; }
+        bool IsMap() const { return Type() == YAML::NodeType::Map; }
+        // The same test as for a YAML::Node, present even if null
+        explicit operator bool() const { return IsDefined(); }
+
+        const std::string& Scalar() const; // empty for anything but a scalar
+        const std::string& Tag() const;
+        YAML::Mark Mark() const;
+        size_t size() const { return IsDefined() ? node->size() : 0; }
+
+        // The value of a scalar key of a map, missing for anything else. Throws
+        // YAML::BadSubscript on a scalar, like YAML::Node::operator[].
+        NodeView operator[](const std::string& key) const;
+        // An item of a sequence, missing past its end
+        NodeView operator[](size_t index) const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+
+        bool is(const NodeView& rhs) const { return node == rhs.node; }
+        // The same for every view of one node, e.g. to remember the nodes already handled
+        const void* Id() const { return node; }
+
+        // The viewed node as a YAML::Node sharing the memory of document, which the view has to
+        // have been taken from, directly or by walking down from it. A missing view gives the
+        // invalid node the const operator[] returns for a missing key.
+        YAML::Node Bind(const YAML::Node& document) const;
+
+    private:
+        explicit NodeView(const YAML::detail::node* node) : node(node) {}
+
+        const YAML::detail::node* node = nullptr;
+    };
+
+    // What an iterator over a view points to: the item of a sequence, or first and second for
+    // the key and value of a map entry, as with YAML::Node
+    struct NodeView::Item : NodeView {
+        NodeView first, second;
+    };
+
+    class NodeView::const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Item;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Item*;
+        using reference = Item;
+
+        const_iterator() = default;
+
+        Item operator*() const;
+        struct Arrow {
+            Item item;
+            const Item* operator->() const { return &item; }
+        };
+        Arrow operator->() const { return Arrow{ **this }; }
+
+        const_iterator& operator++() {
+            ++it;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++it;
+            return previous;
+        }
+        bool operator==(const const_iterator& rhs) const { return it == rhs.it; }
+        bool operator!=(const const_iterator& rhs) const { return it != rhs.it; }
+
+    private:
+        friend class NodeView;
+        explicit const_iterator(YAML::detail::const_node_iterator it) : it(it) {}
+
+        YAML::detail::const_node_iterator it;
+    };
+}
@@ -0,0 +1,110 @@
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+const size_t output_buffer_size = 1 << 20;
+
+static bool SameContents(const std::string& a, const std::string& b) {
+    std::error_code ec;
+    auto sizeA = fs::file_size(a, ec);
+    if (ec) return false;
+    auto sizeB = fs::file_size(b, ec);
+    if (ec || sizeA != sizeB) return false;
+
+    std::ifstream fileA(a, std::ios::binary), fileB(b, std::ios::binary);
+    if (!fileA.is_open() || !fileB.is_open()) return false;
+    std::vector<char> bufferA(1 << 16), bufferB(1 << 16);
+    while (fileA && fileB) {
+        fileA.read(bufferA.data(), bufferA.size());
+        fileB.read(bufferB.data(), bufferB.size());
+        if (fileA.gcount() != fileB.gcount()) return false;
+        if (!std::equal(bufferA.begin(), bufferA.begin() + fileA.gcount(), bufferB.begin())) return false;
+    }
+    return true;
+}
+
+static unsigned long ProcessId() {
+#ifdef _WIN32
+    return static_cast<unsigned long>(GetCurrentProcessId());
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+enum class CreateResult { Created, Exists, Failed };
+
+// Creates the file only if nothing is there yet, so two writers never share a temporary file
+static CreateResult CreateNew(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_EXISTS ? CreateResult::Exists : CreateResult::Failed;
+    }
+    CloseHandle(file);
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        return errno == EEXIST ? CreateResult::Exists : CreateResult::Failed;
+    }
+    close(fd);
+#endif
+    return CreateResult::Created;
+}
+
+const int temp_name_attempts = 100;
+
+OutputFile::OutputFile(const std::string& path) : path(path), buffer(output_buffer_size) {
+    // The process id keeps writers sharing a directory (a cache, a batch output) apart and the
+    // counter the files of one process. The name is only a guess, creating it decides: a file
+    // left behind by a crashed process with the same id makes it try the next one.
+    static std::atomic<unsigned long> counter{ 0 };
+    for (int attempt = 0; attempt < temp_name_attempts; ++attempt) {
+        std::string candidate = path + ".tmp" + std::to_string(ProcessId()) + "-" + std::to_string(counter.fetch_add(1));
+        CreateResult result = CreateNew(candidate);
+        if (result == CreateResult::Exists) continue;
+        if (result == CreateResult::Failed) return;
+        tempPath = candidate;
+        break;
+    }
+    if (tempPath.empty()) return;
+
+    stream.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    stream.open(tempPath, std::ios::binary | std::ios::trunc);
+}
+
+OutputFile::~OutputFile() {
+    if (!committed && !tempPath.empty()) {
+        if (stream.is_open()) stream.close();
+        std::error_code ec;
+        fs::remove(tempPath, ec);
+    }
+}
+
+bool OutputFile::Commit() {
+    stream.close();
+    if (stream.fail()) return false;
+    std::error_code ec;
+    if (SameContents(tempPath, path)) {
+        fs::remove(tempPath, ec);
+        committed = true;
+        unchanged = true;
+        return true;
+    }
+    fs::rename(tempPath, path, ec);
+    if (ec) return false;
+    committed = true;
+    return true;
+}
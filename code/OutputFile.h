@@ -0,0 +1,28 @@
+#pragma once
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes to a temporary file next to the destination and renames it over the
+// destination on Commit(), so readers never see a partially written file.
+// An existing destination with identical contents is left alone to keep its mtime.
+class OutputFile {
+public:
+    explicit OutputFile(const std::string& path);
+    ~OutputFile();
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    bool IsOpen() const { return stream.is_open(); }
+    std::ostream& Stream() { return stream; }
+    bool Commit();
+    bool Unchanged() const { return unchanged; }
+
+private:
+    std::string path;
+    std::string tempPath;
+    std::vector<char> buffer;
+    std::ofstream stream;
+    bool committed = false;
+    bool unchanged = false;
+};
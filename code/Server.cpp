@@ -0,0 +1,392 @@
+#include "Server.h"
+#include "Converter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace server {
+
+#ifdef _WIN32
+
+    int Serve(const Options& options) {
+        std::cerr << "serve is only supported on POSIX systems" << std::endl;
+        return 1;
+    }
+
+#else
+
+    std::atomic<bool> stopping{ false };
+
+    void HandleSignal(int) {
+        stopping = true;
+    }
+
+    bool ReadFully(int fd, void* data, size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t n = read(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool WriteFully(int fd, const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool SendResponse(int fd, Status status, const std::string& body) {
+        Header header{ status, body.size() };
+        return WriteFully(fd, &header, sizeof(header)) && WriteFully(fd, body.data(), body.size());
+    }
+
+    // Closes the descriptor it holds, whichever way the scope is left
+    struct ScopedFd {
+        explicit ScopedFd(int fd) : fd(fd) {}
+        ~ScopedFd() { if (fd >= 0) close(fd); }
+        ScopedFd(const ScopedFd&) = delete;
+        ScopedFd& operator=(const ScopedFd&) = delete;
+        int fd;
+    };
+
+    // Reads a header and, if the client attached one, the passed file descriptor. Any further
+    // descriptors are closed, and so is the passed one when false is returned.
+    bool ReadHeader(int fd, Header& header, int& passedFd) {
+        passedFd = -1;
+        // aligned for cmsghdr, CMSG_FIRSTHDR hands out the start of the buffer
+        union {
+            char buf[CMSG_SPACE(sizeof(int))];
+            cmsghdr align;
+        } control;
+        iovec iov{ &header, sizeof(header) };
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        ssize_t n;
+        do {
+            n = recvmsg(fd, &msg, flags);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; ++i) {
+                int received;
+                std::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (passedFd < 0) passedFd = received;
+                else close(received);
+            }
+        }
+        // descriptors that did not fit were closed by the kernel, the one kept may not be the
+        // one the client meant
+        if ((msg.msg_flags & MSG_CTRUNC) != 0 ||
+            (static_cast<size_t>(n) < sizeof(header) && !ReadFully(fd, reinterpret_cast<char*>(&header) + n, sizeof(header) - n))) {
+            if (passedFd >= 0) close(passedFd);
+            passedFd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // A length of 0 stands for the size of the file
+    bool PassedFileLength(int fd, uint64_t& length) {
+        if (length != 0) return true;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        length = static_cast<uint64_t>(st.st_size);
+        return true;
+    }
+
+    bool ReadPassedFile(int fd, uint64_t length, std::string& data) {
+        data.resize(length);
+        size_t offset = 0;
+        while (offset < length) {
+            ssize_t n = pread(fd, &data[offset], length - offset, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            offset += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Keeps the most recent request latencies for percentile reporting.
+    class LatencyStats {
+    public:
+        void Record(double milliseconds, bool success) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (samples.size() < max_samples) {
+                samples.push_back(milliseconds);
+            }
+            else {
+                samples[next] = milliseconds;
+            }
+            next = (next + 1) % max_samples;
+            ++requests;
+            if (!success) ++errors;
+        }
+
+        std::string Report() {
+            std::vector<double> sorted;
+            uint64_t total, failed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                sorted = samples;
+                total = requests;
+                failed = errors;
+            }
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&sorted](double p) {
+                if (sorted.empty()) return 0.0;
+                size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+                return sorted[index];
+            };
+
+            std::ostringstream out;
+            out << "requests: " << total << "\n";
+            out << "errors: " << failed << "\n";
+            out << "p50_ms: " << percentile(0.50) << "\n";
+            out << "p90_ms: " << percentile(0.90) << "\n";
+            out << "p99_ms: " << percentile(0.99) << "\n";
+            out << "max_ms: " << (sorted.empty() ? 0.0 : sorted.back()) << "\n";
+            return out.str();
+        }
+
+    private:
+        static const size_t max_samples = 65536;
+        std::mutex mutex;
+        std::vector<double> samples;
+        size_t next = 0;
+        uint64_t requests = 0;
+        uint64_t errors = 0;
+    };
+
+    // Serves the request waiting on a connection. False once the connection is done with, because
+    // the client closed it, the request was malformed or the response could not be sent.
+    bool HandleRequest(int fd, uint64_t maxRequestSize, Converter& converter, LatencyStats& stats) {
+        Header header;
+        int passedFd;
+        if (!ReadHeader(fd, header, passedFd)) return false;
+        ScopedFd passed(passedFd);
+        if (header.code == OpStats) {
+            return SendResponse(fd, StatusOk, stats.Report());
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::string spec;
+        std::string problem = "Malformed request";
+        bool received = false;
+        // the length comes from the client, nothing is allocated before it is checked
+        uint64_t length = header.length;
+        bool known = header.code == OpConvert || (header.code == OpConvertFd && passedFd >= 0 && PassedFileLength(passedFd, length));
+        if (known && length > maxRequestSize) {
+            problem = "Request exceeds the maximum size of " + std::to_string(maxRequestSize) + " bytes";
+        }
+        else if (known && header.code == OpConvertFd) {
+            received = ReadPassedFile(passedFd, length, spec);
+        }
+        else if (known) {
+            spec.resize(length);
+            received = ReadFully(fd, &spec[0], spec.size());
+        }
+        if (!received) {
+            SendResponse(fd, StatusError, problem);
+            return false;
+        }
+
+        Status status = StatusOk;
+        std::string error;
+        const std::string* result = &error;
+        try {
+            result = &converter.ConvertToBuffer(spec.data(), spec.size());
+        }
+        catch (const std::exception& err) {
+            status = StatusError;
+            error = err.what();
+            result = &error;
+        }
+        stats.Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), status == StatusOk);
+
+        return SendResponse(fd, status, *result);
+    }
+
+    int Serve(const Options& options) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (options.socket.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Socket path is too long: " << options.socket << std::endl;
+            return 1;
+        }
+        std::memcpy(addr.sun_path, options.socket.c_str(), options.socket.size() + 1);
+
+        int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            std::cerr << "Failed to create socket" << std::endl;
+            return 1;
+        }
+        unlink(options.socket.c_str());
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << "Failed to listen on " << options.socket << std::endl;
+            close(listenFd);
+            return 1;
+        }
+
+        // workers write a byte here when they hand a connection back, so the poll below wakes
+        int wake[2];
+        if (pipe(wake) != 0 || fcntl(wake[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(wake[1], F_SETFL, O_NONBLOCK) != 0) {
+            std::cerr << "Failed to create the wakeup pipe" << std::endl;
+            close(listenFd);
+            return 1;
+        }
+
+        std::signal(SIGINT, HandleSignal);
+        std::signal(SIGTERM, HandleSignal);
+
+        LatencyStats stats;
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::queue<int> connections;
+        std::vector<int> returned;
+
+        // A worker serves one request and hands the connection back, idle connections wait in the
+        // poll of the accept loop and any number of them hold no worker
+        unsigned workerCount = options.workers ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < workerCount; ++i) {
+            workers.emplace_back([&]() {
+                Converter converter;
+                while (true) {
+                    int fd;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ready.wait(lock, [&]() { return stopping || !connections.empty(); });
+                        if (connections.empty()) return;
+                        fd = connections.front();
+                        connections.pop();
+                    }
+                    // whatever a client sends costs at most its own connection
+                    bool keep = false;
+                    try {
+                        keep = HandleRequest(fd, options.maxRequestSize, converter, stats);
+                    }
+                    catch (const std::exception& err) {
+                        std::cerr << "Dropped a connection: " << err.what() << std::endl;
+                    }
+                    if (!keep || stopping) {
+                        close(fd);
+                        continue;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        returned.push_back(fd);
+                    }
+                    char byte = 0;
+                    ssize_t written = write(wake[1], &byte, 1);
+                    (void)written;  // a full pipe already wakes the poll
+                }
+            });
+        }
+
+        std::cerr << "Listening on " << options.socket << " with " << workerCount << " workers" << std::endl;
+        // a client that stops halfway through a request or a response loses its connection
+        // instead of keeping a worker
+        timeval timeout{ 10, 0 };
+        std::vector<int> idle;
+        std::vector<pollfd> polled;
+        while (!stopping) {
+            polled.assign({ pollfd{ listenFd, POLLIN, 0 }, pollfd{ wake[0], POLLIN, 0 } });
+            for (int fd : idle) {
+                polled.push_back(pollfd{ fd, POLLIN, 0 });
+            }
+            if (poll(polled.data(), polled.size(), 500) <= 0) continue;
+
+            // a closed or broken connection is readable too, its worker finds out and closes it
+            size_t kept = 0;
+            bool dispatched = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < idle.size(); ++i) {
+                    if (polled[i + 2].revents != 0) {
+                        connections.push(idle[i]);
+                        dispatched = true;
+                    }
+                    else {
+                        idle[kept++] = idle[i];
+                    }
+                }
+                idle.resize(kept);
+                if (polled[1].revents != 0) {
+                    char drain[64];
+                    while (read(wake[0], drain, sizeof(drain)) > 0) {}
+                    idle.insert(idle.end(), returned.begin(), returned.end());
+                    returned.clear();
+                }
+            }
+            if (dispatched) ready.notify_all();
+
+            if (polled[0].revents != 0) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0) continue;
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                idle.push_back(fd);
+            }
+        }
+
+        close(listenFd);
+        unlink(options.socket.c_str());
+        ready.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (int fd : idle) {
+            close(fd);
+        }
+        for (int fd : returned) {
+            close(fd);
+        }
+        close(wake[0]);
+        close(wake[1]);
+        std::cerr << stats.Report();
+        return 0;
+    }
+
+#endif
+}
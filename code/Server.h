@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace server {
+
+    // Every request and response on the socket starts with this header, followed by length bytes.
+    // OpConvertFd carries no payload, the spec is read from a memfd passed along with the header.
+    enum Op : uint32_t {
+        OpConvert = 1,
+        OpConvertFd = 2,
+        OpStats = 3,
+    };
+
+    enum Status : uint32_t {
+        StatusOk = 0,
+        StatusError = 1,
+    };
+
+#pragma pack(push, 1)
+    struct Header {
+        uint32_t code;
+        uint64_t length;
+    };
+#pragma pack(pop)
+
+    struct Options {
+        std::string socket;
+        unsigned workers = 0;
+        uint64_t maxRequestSize = 512ull * 1024 * 1024; // larger specs are refused before reading them
+    };
+
+    struct ClientOptions {
+        std::string socket;
+        std::string input;
+        std::string output;
+        unsigned repeat = 1;
+        bool memfd = false;
+        bool stats = false;
+    };
+
+#ifndef _WIN32
+    bool ReadFully(int fd, void* data, size_t size);
+    bool WriteFully(int fd, const void* data, size_t size);
+#endif
+
+    int Serve(const Options& options);
+
+    int RunClient(const ClientOptions& options);
+}
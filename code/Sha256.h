@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Sha256 {
+public:
+    Sha256();
+    void Update(const void* data, size_t size);
+    void Update(const std::string& data) { Update(data.data(), data.size()); }
+    std::string HexDigest();
+
+private:
+    void Transform(const uint8_t* block);
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t blockSize = 0;
+    uint64_t totalSize = 0;
+};
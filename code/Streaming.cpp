@@ -0,0 +1,380 @@
+#include "Streaming.h"
+#include "JsonParser.h"
+#include "MappedFile.h"
+#include "Util.h"
+
+#include <istream>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace streaming {
+
+    namespace {
+
+        const char paths_ref[] = "#/paths/";
+
+        // Where a node of the event stream belongs
+        enum class Place {
+            Rest,      // anything outside the paths entry
+            PathsKey,  // the "paths" key of the root map
+            Paths,     // the paths map itself
+            ItemKey,   // the path of a path item
+            ItemValue, // a path item
+            InItem     // a node within either of them
+        };
+
+        // Follows the events through the root map and the paths map
+        class Position {
+        public:
+            // Call for every node before it is opened, or right away for a scalar
+            Place Enter(bool container, bool map, const std::string* scalar) {
+                Place place = Locate(scalar);
+                if (depth == 0) rootIsMap = container && map;
+                if (place == Place::Paths) {
+                    inPaths = true;
+                    pathsDepth = depth + 1;
+                    pathsKey = true;
+                }
+                if (container) {
+                    ++depth;
+                    places.push_back(place);
+                }
+                else {
+                    Complete(place);
+                }
+                return place;
+            }
+
+            // Call at the end of a container, gives where it belonged
+            Place Exit() {
+                --depth;
+                Place place = places.back();
+                places.pop_back();
+                Complete(place);
+                return place;
+            }
+
+            bool rootIsMap = false;
+            bool duplicatePaths = false;
+
+        private:
+            Place Locate(const std::string* scalar) {
+                if (inPaths) {
+                    if (depth > pathsDepth) return Place::InItem;
+                    return pathsKey ? Place::ItemKey : Place::ItemValue;
+                }
+                if (depth == 1 && rootIsMap) {
+                    if (rootKey && scalar && *scalar == "paths") {
+                        if (!seenPaths) return Place::PathsKey;
+                        duplicatePaths = true;
+                    }
+                    if (!rootKey && nextIsPaths) return Place::Paths;
+                }
+                return Place::Rest;
+            }
+
+            // The node is complete, depth is back at its parent
+            void Complete(Place place) {
+                if (place == Place::PathsKey) {
+                    seenPaths = true;
+                    nextIsPaths = true;
+                }
+                else if (place == Place::Paths) {
+                    inPaths = false;
+                    nextIsPaths = false;
+                }
+                if (inPaths && depth == pathsDepth) pathsKey = !pathsKey;
+                if (depth == 1 && rootIsMap && !inPaths) rootKey = !rootKey;
+            }
+
+            int depth = 0;
+            std::vector<Place> places; // of the open containers
+            bool rootKey = true;       // the next node of the root map is a key
+            bool seenPaths = false;
+            bool nextIsPaths = false;
+            bool inPaths = false;
+            int pathsDepth = 0;
+            bool pathsKey = true;      // the next node of the paths map is a key
+        };
+
+        bool InPaths(Place place) {
+            return place != Place::Rest && place != Place::PathsKey;
+        }
+
+        // First pass, everything outside the paths entry goes to the builder
+        class OutlineHandler : public YAML::EventHandler {
+        public:
+            OutlineHandler(compact::Document& rest, Outline& outline, const char* data, size_t size)
+                : builder(rest, data, size), outline(outline) {}
+
+            void OnDocumentStart(const YAML::Mark& mark) override {
+                builder.OnDocumentStart(mark);
+            }
+
+            void OnDocumentEnd() override {
+                builder.OnDocumentEnd();
+                outline.rootIsMap = position.rootIsMap;
+                if (position.duplicatePaths) outline.crossReferences = true;
+            }
+
+            void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                Place place = position.Enter(false, false, nullptr);
+                Anchor(place, anchor);
+                lastWasRef = false;
+                if (place == Place::Rest) builder.OnNull(mark, anchor);
+            }
+
+            void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                Place place = position.Enter(false, false, nullptr);
+                if (InPaths(place) ? itemAnchors.count(anchor) == 0 : pathAnchors.count(anchor) != 0) {
+                    outline.crossReferences = true;
+                }
+                lastWasRef = false;
+                if (place == Place::Rest && !outline.crossReferences) builder.OnAlias(mark, anchor);
+            }
+
+            void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override {
+                Place place = position.Enter(false, false, &value);
+                Anchor(place, anchor);
+                if (lastWasRef && value.compare(0, 8, paths_ref) == 0) outline.crossReferences = true;
+                lastWasRef = value == "$ref";
+                if (place == Place::Rest) builder.OnScalar(mark, tag, anchor, value);
+            }
+
+            void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                Place place = position.Enter(true, false, nullptr);
+                Container(place, anchor, false, style);
+                if (place == Place::Rest) builder.OnSequenceStart(mark, tag, anchor, style);
+            }
+
+            void OnSequenceEnd() override {
+                if (position.Exit() == Place::Rest) builder.OnSequenceEnd();
+            }
+
+            void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                Place place = position.Enter(true, true, nullptr);
+                Container(place, anchor, true, style);
+                if (place == Place::Rest) builder.OnMapStart(mark, tag, anchor, style);
+            }
+
+            void OnMapEnd() override {
+                if (position.Exit() == Place::Rest) builder.OnMapEnd();
+            }
+
+        private:
+            void Container(Place place, YAML::anchor_t anchor, bool map, YAML::EmitterStyle::value style) {
+                Anchor(place, anchor);
+                lastWasRef = false;
+                if (place == Place::Paths) {
+                    outline.pathsIsMap = map;
+                    outline.pathsStyle = style;
+                }
+            }
+
+            // Anchors are only followed within the path item that holds them
+            void Anchor(Place place, YAML::anchor_t anchor) {
+                if (place == Place::Paths) outline.hasPaths = true;
+                if (place == Place::ItemKey) itemAnchors.clear();
+                if (anchor == YAML::NullAnchor || !InPaths(place)) return;
+                pathAnchors.insert(anchor);
+                itemAnchors.insert(anchor);
+            }
+
+            compact::Builder builder;
+            Outline& outline;
+            Position position;
+            std::unordered_set<YAML::anchor_t> pathAnchors; // defined anywhere in paths
+            std::unordered_set<YAML::anchor_t> itemAnchors; // defined in the current path item
+            bool lastWasRef = false;                        // the last scalar was "$ref"
+        };
+
+        // Second pass, each path item goes to a document of its own
+        class ItemHandler : public YAML::EventHandler {
+        public:
+            ItemHandler(const std::function<void(const compact::Document&)>& handle, const char* data, size_t size)
+                : handle(handle), data(data), size(size) {}
+
+            void OnDocumentStart(const YAML::Mark&) override {}
+            void OnDocumentEnd() override {}
+
+            void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                Place place = Begin(position.Enter(false, false, nullptr), mark);
+                if (builder) builder->OnNull(mark, anchor);
+                End(place);
+            }
+
+            void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                Place place = Begin(position.Enter(false, false, nullptr), mark);
+                if (builder) builder->OnAlias(mark, anchor);
+                End(place);
+            }
+
+            void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override {
+                Place place = Begin(position.Enter(false, false, &value), mark);
+                if (builder) builder->OnScalar(mark, tag, anchor, value);
+                End(place);
+            }
+
+            void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                Begin(position.Enter(true, false, nullptr), mark);
+                if (builder) builder->OnSequenceStart(mark, tag, anchor, style);
+            }
+
+            void OnSequenceEnd() override {
+                if (builder) builder->OnSequenceEnd();
+                End(position.Exit());
+            }
+
+            void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                Begin(position.Enter(true, true, nullptr), mark);
+                if (builder) builder->OnMapStart(mark, tag, anchor, style);
+            }
+
+            void OnMapEnd() override {
+                if (builder) builder->OnMapEnd();
+                End(position.Exit());
+            }
+
+        private:
+            // The path of an item opens a document holding a map with the item as its one entry
+            Place Begin(Place place, const YAML::Mark& mark) {
+                if (place == Place::ItemKey && !builder) {
+                    item = compact::Document();
+                    builder.reset(new compact::Builder(item, data, size));
+                    builder->OnDocumentStart(mark);
+                    builder->OnMapStart(mark, "?", YAML::NullAnchor, YAML::EmitterStyle::Default);
+                }
+                return place;
+            }
+
+            // A complete item is handed out and dropped
+            void End(Place place) {
+                if (place != Place::ItemValue || !builder) return;
+                builder->OnMapEnd();
+                builder->OnDocumentEnd();
+                builder.reset();
+                handle(item);
+                item = compact::Document();
+            }
+
+            const std::function<void(const compact::Document&)>& handle;
+            const char* data;
+            size_t size;
+            Position position;
+            compact::Document item;
+            std::unique_ptr<compact::Builder> builder;
+        };
+
+        void Parse(const char* data, size_t size, bool json, YAML::EventHandler& handler) {
+            if (json) {
+                json::Parse(data, size, handler);
+                return;
+            }
+            MemoryStreamBuf buffer(data, size);
+            std::istream stream(&buffer);
+            YAML::Parser parser(stream);
+            parser.HandleNextDocument(handler);
+        }
+
+        // A document holding a map with the one entry
+        compact::Document ReadIndexed(const char* data, const Outline& outline, const structural::Entry& entry) {
+            compact::Document document;
+            compact::Builder builder(document, data, entry.end);
+            builder.OnDocumentStart(YAML::Mark());
+            builder.OnMapStart(YAML::Mark(), "?", YAML::NullAnchor, YAML::EmitterStyle::Default);
+            structural::ParseEntry(data, outline.index, entry, builder);
+            builder.OnMapEnd();
+            builder.OnDocumentEnd();
+            return document;
+        }
+    }
+
+    const Deferred* Outline::Find(const std::string& pointer) const {
+        for (const Deferred& part : deferred) {
+            if (part.pointer == pointer) return &part;
+        }
+        return nullptr;
+    }
+
+    Outline ReadOutline(const char* data, size_t size, compact::Document& rest,
+        const std::function<bool(const std::string& key)>& needed) {
+        // the index does not look into scalars, a $ref into paths is searched for in the raw text
+        // and left to the exact check of the event pass
+        Outline indexed;
+        if (std::string_view(data, size).find(paths_ref) == std::string_view::npos && structural::Build(data, size, indexed.index)) {
+            indexed.indexed = true;
+            indexed.json = indexed.index.json;
+            indexed.rootIsMap = true;
+            indexed.hasPaths = true;
+            indexed.pathsIsMap = true;
+            indexed.pathsStyle = indexed.json ? YAML::EmitterStyle::Flow : YAML::EmitterStyle::Block;
+            compact::Builder builder(rest, data, size);
+            builder.OnDocumentStart(YAML::Mark());
+            builder.OnMapStart(YAML::Mark(), "?", YAML::NullAnchor, indexed.pathsStyle);
+            for (const structural::Entry& entry : indexed.index.entries) {
+                if (entry.key == "paths") continue;
+                std::string pointer = "#/" + util::EncodeKey(entry.key);
+                if (entry.key == "components" && !indexed.index.components.empty()) {
+                    // split up, so the entries the conversion does not read can be left as well
+                    builder.OnScalar(YAML::Mark(), indexed.json ? "!" : "?", YAML::NullAnchor, entry.key);
+                    builder.OnMapStart(YAML::Mark(), "?", YAML::NullAnchor, indexed.pathsStyle);
+                    for (const structural::Entry& component : indexed.index.components) {
+                        std::string componentPointer = pointer + "/" + util::EncodeKey(component.key);
+                        if (needed(componentPointer)) structural::ParseEntry(data, indexed.index, component, builder);
+                        else indexed.deferred.push_back(Deferred{ componentPointer, component });
+                    }
+                    builder.OnMapEnd();
+                }
+                else if (needed(pointer)) {
+                    structural::ParseEntry(data, indexed.index, entry, builder);
+                }
+                else {
+                    indexed.deferred.push_back(Deferred{ pointer, entry });
+                }
+            }
+            builder.OnMapEnd();
+            builder.OnDocumentEnd();
+            return indexed;
+        }
+
+        if (json::IsJson(data, size)) {
+            try {
+                Outline outline;
+                outline.json = true;
+                OutlineHandler handler(rest, outline, data, size);
+                Parse(data, size, true, handler);
+                return outline;
+            }
+            catch (const json::NotStrictJson&) {
+                // not strict JSON, e.g. a YAML flow mapping with plain keys
+                rest = compact::Document();
+            }
+        }
+        Outline outline;
+        OutlineHandler handler(rest, outline, data, size);
+        Parse(data, size, false, handler);
+        return outline;
+    }
+
+    void ReadPathItems(const char* data, size_t size, const Outline& outline,
+        const std::function<void(const compact::Document& item)>& handle) {
+        if (outline.indexed) {
+            for (const structural::Entry& entry : outline.index.paths) {
+                handle(ReadIndexed(data, outline, entry));
+            }
+            return;
+        }
+        ItemHandler handler(handle, data, size);
+        Parse(data, size, outline.json, handler);
+    }
+
+    compact::Document ReadEntry(const char* data, const Outline& outline, const Deferred& part) {
+        return ReadIndexed(data, outline, part.entry);
+    }
+
+    void ReadValue(const char* data, const Outline& outline, const Deferred& part, YAML::EventHandler& handler) {
+        structural::ParseValue(data, outline.index, part.entry, handler);
+    }
+}
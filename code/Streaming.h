@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "CompactDocument.h"
+#include "StructuralIndex.h"
+
+// Two passes over a spec held in memory, so the path items never have to be held all at once:
+// the first builds everything else, the second hands out one path item at a time. The documents
+// built keep scalars as ranges of the input, which has to outlive them.
+namespace streaming {
+
+    // An entry the first pass did not parse, at the top level or in components
+    struct Deferred {
+        std::string pointer; // e.g. "#/info" or "#/components/examples"
+        structural::Entry entry;
+    };
+
+    struct Outline {
+        bool json = false;       // parsed by json::Parse, the second pass has to use it as well
+        bool rootIsMap = false;
+        bool hasPaths = false;
+        bool pathsIsMap = false;
+        YAML::EmitterStyle::value pathsStyle = YAML::EmitterStyle::Default;
+        // An alias reaching into or out of a path item, or a $ref into paths. Such a document
+        // needs all of its path items at hand.
+        bool crossReferences = false;
+        // Set when the input could be cut into entries, each pass then only parses its own
+        bool indexed = false;
+        structural::Index index;
+        std::vector<Deferred> deferred; // left out of rest, in document order
+
+        const Deferred* Find(const std::string& pointer) const;
+
+        bool Streamable() const { return rootIsMap && (!hasPaths || pathsIsMap) && !crossReferences; }
+    };
+
+    // First pass: builds the document without the paths entry into rest. When the input can be
+    // indexed, entries whose pointer needed rejects are not parsed at all. The entries of
+    // components are asked for one by one, when the index has them, the others as a whole.
+    Outline ReadOutline(const char* data, size_t size, compact::Document& rest,
+        const std::function<bool(const std::string& pointer)>& needed);
+
+    // Second pass: hands each path item to handle as soon as its events are complete, as a
+    // document holding a map with that one entry
+    void ReadPathItems(const char* data, size_t size, const Outline& outline,
+        const std::function<void(const compact::Document& item)>& handle);
+
+    // Parses an entry the first pass left out, as a document holding a map with that one entry
+    compact::Document ReadEntry(const char* data, const Outline& outline, const Deferred& part);
+    // Reports the events of its value, without building anything
+    void ReadValue(const char* data, const Outline& outline, const Deferred& part, YAML::EventHandler& handler);
+}
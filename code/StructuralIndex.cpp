@@ -0,0 +1,505 @@
+#include "StructuralIndex.h"
+#include "JsonParser.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <istream>
+#include <unordered_set>
+#include "yaml-cpp/yaml.h"
+
+namespace structural {
+
+    namespace {
+
+        const char* SkipBom(const char* p, const char* end) {
+            if (end - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) return p + 3;
+            return p;
+        }
+
+        // Skips strings, objects and arrays without looking into them beyond their brackets.
+        // The entries are checked by json::ParseValue once they are parsed.
+        class JsonScanner {
+        public:
+            JsonScanner(const char* data, size_t size) : data(data), end(data + size) {}
+
+            bool Build(Index& index) {
+                const char* p = SkipWhitespace(SkipBom(data, end));
+                if (p == end || *p != '{') return false;
+                p = Entries(p + 1, index.entries);
+                if (!p || SkipWhitespace(p) != end) return false;
+                for (const Entry& entry : index.entries) {
+                    if (entry.key == "paths") {
+                        if (!index.paths.empty() || data[entry.value] != '{') return false;
+                        if (!Entries(data + entry.value + 1, index.paths) || index.paths.empty()) return false;
+                    }
+                    else if (entry.key == "components" && index.components.empty() && data[entry.value] == '{') {
+                        if (!Entries(data + entry.value + 1, index.components)) index.components.clear();
+                    }
+                }
+                return !index.paths.empty();
+            }
+
+        private:
+            // The entries of an object up to its closing brace, nullptr if it is malformed
+            const char* Entries(const char* p, std::vector<Entry>& entries) {
+                p = SkipWhitespace(p);
+                if (p < end && *p == '}') return p + 1;
+                while (p < end) {
+                    if (*p != '"') return nullptr;
+                    Entry entry;
+                    entry.begin = p - data;
+                    bool escaped = false;
+                    p = SkipString(p, escaped);
+                    if (!p) return nullptr;
+                    entry.keyEnd = p - data;
+                    if (!Key(entry, escaped)) return nullptr;
+                    p = SkipWhitespace(p);
+                    if (p == end || *p != ':') return nullptr;
+                    p = SkipWhitespace(p + 1);
+                    entry.value = p - data;
+                    p = SkipValue(p);
+                    if (!p) return nullptr;
+                    entry.end = p - data;
+                    entries.push_back(std::move(entry));
+                    p = SkipWhitespace(p);
+                    if (p == end) return nullptr;
+                    if (*p == '}') return p + 1;
+                    if (*p != ',') return nullptr;
+                    p = SkipWhitespace(p + 1);
+                }
+                return nullptr;
+            }
+
+            bool Key(Entry& entry, bool escaped) {
+                if (!escaped) {
+                    entry.key.assign(data + entry.begin + 1, entry.keyEnd - entry.begin - 2);
+                    return true;
+                }
+                struct KeyHandler : YAML::EventHandler {
+                    std::string& key;
+                    explicit KeyHandler(std::string& key) : key(key) {}
+                    void OnDocumentStart(const YAML::Mark&) override {}
+                    void OnDocumentEnd() override {}
+                    void OnNull(const YAML::Mark&, YAML::anchor_t) override {}
+                    void OnAlias(const YAML::Mark&, YAML::anchor_t) override {}
+                    void OnScalar(const YAML::Mark&, const std::string&, YAML::anchor_t, const std::string& value) override { key = value; }
+                    void OnSequenceStart(const YAML::Mark&, const std::string&, YAML::anchor_t, YAML::EmitterStyle::value) override {}
+                    void OnSequenceEnd() override {}
+                    void OnMapStart(const YAML::Mark&, const std::string&, YAML::anchor_t, YAML::EmitterStyle::value) override {}
+                    void OnMapEnd() override {}
+                } handler(entry.key);
+                try {
+                    json::ParseValue(data + entry.begin, entry.keyEnd - entry.begin, handler);
+                }
+                catch (const YAML::ParserException&) {
+                    return false;
+                }
+                return true;
+            }
+
+            // Past the closing quote, found with memchr; a quote is escaped when an odd number of
+            // backslashes precedes it
+            const char* SkipString(const char* p, bool& escaped) {
+                const char* begin = ++p;
+                while (p < end) {
+                    const char* quote = static_cast<const char*>(std::memchr(p, '"', end - p));
+                    if (!quote) return nullptr;
+                    const char* q = quote;
+                    while (q > begin && q[-1] == '\\') --q;
+                    if (q != quote) escaped = true;
+                    if ((quote - q) % 2 == 0) return quote + 1;
+                    p = quote + 1;
+                }
+                return nullptr;
+            }
+
+            const char* SkipValue(const char* p) {
+                if (p == end) return nullptr;
+                bool escaped = false;
+                if (*p == '"') return SkipString(p, escaped);
+                if (*p != '{' && *p != '[') {
+                    while (p < end && !std::strchr(",}] \t\r\n", *p)) ++p;
+                    return p;
+                }
+                size_t depth = 0;
+                while (p < end) {
+                    char c = *p;
+                    if (c == '"') {
+                        p = SkipString(p, escaped);
+                        if (!p) return nullptr;
+                        continue;
+                    }
+                    if (c == '{' || c == '[') ++depth;
+                    else if (c == '}' || c == ']') {
+                        if (--depth == 0) return p + 1;
+                    }
+                    ++p;
+                }
+                return nullptr;
+            }
+
+            const char* SkipWhitespace(const char* p) {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+                return p;
+            }
+
+            const char* data;
+            const char* end;
+        };
+
+        // Goes through a block-style YAML document line by line, only as far into each line as it
+        // takes to know where scalars and collections end. Entries start at the lines whose
+        // indentation is that of the root map or of the paths map.
+        class YamlScanner {
+        public:
+            YamlScanner(const char* data, size_t size) : data(data), end(data + size) {}
+
+            bool Build(Index& index) {
+                bool started = false;
+                std::vector<Entry>* nested = nullptr; // the entries of paths or components, while in them
+                size_t nestedIndent = 0;
+                for (const char* line = SkipBom(data, end); line < end;) {
+                    const char* next = static_cast<const char*>(std::memchr(line, '\n', end - line));
+                    next = next ? next + 1 : end;
+                    const char* lineEnd = next;
+                    while (lineEnd > line && (lineEnd[-1] == '\n' || lineEnd[-1] == '\r')) --lineEnd;
+                    lineBegin = line;
+                    const char* p = line;
+                    while (p < lineEnd && *p == ' ') ++p;
+                    size_t indent = p - line;
+                    line = next;
+
+                    if (blockParent >= 0) {
+                        if (p == lineEnd || static_cast<long>(indent) > blockParent) continue;
+                        blockParent = -1;
+                    }
+                    if (quote || flowDepth > 0) {
+                        if (!Scan(p, lineEnd, indent)) return false;
+                        continue;
+                    }
+                    if (p == lineEnd || *p == '#') continue;
+                    if (*p == '\t') return false;
+
+                    if (indent == 0) {
+                        if (IsMarker(p, lineEnd, "---") && !started) continue;
+                        if (*p == '%' || IsMarker(p, lineEnd, "...")) return false;
+                        if (*p == '-' && IsSpace(p + 1, lineEnd)) {
+                            // a sequence may sit at the indentation of the key it belongs to
+                            if (!started || nested || !Scan(p, lineEnd, 0)) return false;
+                            continue;
+                        }
+                        started = true;
+                        Entry entry;
+                        entry.begin = p - data;
+                        const char* value = Key(p, lineEnd, entry.key);
+                        if (!value) return false;
+                        Close(index, nested, entry.begin);
+                        nested = nullptr;
+                        nestedIndent = 0;
+                        if (entry.key == "paths") {
+                            if (!index.paths.empty() || !Blank(value, lineEnd)) return false;
+                            nested = &index.paths;
+                        }
+                        // components written in flow style are simply not split up
+                        else if (entry.key == "components" && index.components.empty() && Blank(value, lineEnd)) {
+                            nested = &index.components;
+                        }
+                        index.entries.push_back(std::move(entry));
+                        if (!Scan(value, lineEnd, 0)) return false;
+                        continue;
+                    }
+                    if (!started) return false;
+                    if (nested) {
+                        if (nestedIndent == 0) nestedIndent = indent;
+                        if (indent < nestedIndent) return false;
+                        if (indent == nestedIndent) {
+                            Entry entry;
+                            entry.begin = lineBegin - data;
+                            const char* value = Key(p, lineEnd, entry.key);
+                            if (!value) return false;
+                            if (!nested->empty()) nested->back().end = entry.begin;
+                            nested->push_back(std::move(entry));
+                            if (!Scan(value, lineEnd, indent)) return false;
+                            continue;
+                        }
+                    }
+                    if (!Scan(p, lineEnd, indent)) return false;
+                }
+                if (quote || flowDepth > 0) return false;
+                Close(index, nested, end - data);
+                if (index.paths.empty()) return false;
+                std::unordered_set<std::string> keys;
+                for (const Entry& entry : index.entries) {
+                    if (!keys.insert(entry.key).second) return false;
+                }
+                return true;
+            }
+
+        private:
+            // The top-level entry before offset ends there, and so does the last of its own entries
+            void Close(Index& index, std::vector<Entry>* nested, size_t offset) {
+                if (index.entries.empty()) return;
+                index.entries.back().end = offset;
+                if (nested && !nested->empty()) nested->back().end = offset;
+            }
+
+            static bool IsMarker(const char* p, const char* lineEnd, const char* marker) {
+                return lineEnd - p >= 3 && std::memcmp(p, marker, 3) == 0 && Blank(p + 3, lineEnd);
+            }
+
+            // Nothing but spaces and a comment
+            static bool Blank(const char* p, const char* lineEnd) {
+                while (p < lineEnd && (*p == ' ' || *p == '\t')) ++p;
+                return p == lineEnd || *p == '#';
+            }
+
+            static bool IsSpace(const char* p, const char* lineEnd) {
+                return p == lineEnd || *p == ' ' || *p == '\t';
+            }
+
+            // The key of an entry line, plain or quoted without escapes. Gives where its value
+            // starts, nullptr for anything else.
+            const char* Key(const char* p, const char* lineEnd, std::string& key) {
+                key.clear();
+                if (*p == '"' || *p == '\'') {
+                    char q = *p++;
+                    for (; p < lineEnd; ++p) {
+                        if (*p == '\\' && q == '"') return nullptr;
+                        if (*p == q) {
+                            if (q == '\'' && p + 1 < lineEnd && p[1] == '\'') ++p;
+                            else break;
+                        }
+                        key += *p;
+                    }
+                    if (p == lineEnd) return nullptr;
+                    ++p;
+                    while (p < lineEnd && *p == ' ') ++p;
+                    if (p == lineEnd || *p != ':' || !IsSpace(p + 1, lineEnd)) return nullptr;
+                    return p + 1;
+                }
+                if (std::strchr(",[]{}#&*!|>%@`", *p)) return nullptr;
+                if (std::strchr("-?:", *p) && IsSpace(p + 1, lineEnd)) return nullptr;
+                const char* begin = p;
+                for (; p < lineEnd; ++p) {
+                    if (*p == ':' && IsSpace(p + 1, lineEnd)) break;
+                    if (*p == '#' && (p[-1] == ' ' || p[-1] == '\t')) return nullptr;
+                }
+                if (p == lineEnd) return nullptr;
+                const char* keyEnd = p;
+                while (keyEnd > begin && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t')) --keyEnd;
+                key.assign(begin, keyEnd);
+                return p + 1;
+            }
+
+            // Past the closing quote on this line, or lineEnd with the scalar still open
+            const char* SkipQuoted(const char* p, const char* lineEnd) {
+                while (p < lineEnd) {
+                    if (quote == '"' && *p == '\\') {
+                        p += 2;
+                        continue;
+                    }
+                    if (*p == quote) {
+                        if (quote == '\'' && p + 1 < lineEnd && p[1] == '\'') {
+                            p += 2;
+                            continue;
+                        }
+                        quote = 0;
+                        return p + 1;
+                    }
+                    ++p;
+                }
+                return lineEnd;
+            }
+
+            // The rest of a line from p, parent being the column of the node it belongs to. False
+            // on an anchor, alias or complex key, which would tie entries together.
+            bool Scan(const char* p, const char* lineEnd, size_t parent) {
+                bool tokenStart = true; // the next character starts a node
+                bool plain = false;     // within a plain scalar
+                size_t tokenColumn = parent;
+                while (p < lineEnd) {
+                    if (quote) {
+                        p = SkipQuoted(p, lineEnd);
+                        continue;
+                    }
+                    char c = *p;
+                    if (c == ' ' || c == '\t') {
+                        ++p;
+                        continue;
+                    }
+                    if (c == '#' && (p == lineBegin || p[-1] == ' ' || p[-1] == '\t')) return true;
+                    if (flowDepth > 0) {
+                        if (c == ',' || c == '[' || c == '{') {
+                            if (c != ',') ++flowDepth;
+                            tokenStart = true;
+                            plain = false;
+                            ++p;
+                            continue;
+                        }
+                        if (c == ']' || c == '}') {
+                            --flowDepth;
+                            tokenStart = false;
+                            plain = false;
+                            ++p;
+                            continue;
+                        }
+                    }
+                    if (tokenStart) {
+                        switch (c) {
+                        case '&':
+                        case '*':
+                        case '%':
+                        case '@':
+                        case '`':
+                            return false;
+                        case '?':
+                            if (IsSpace(p + 1, lineEnd)) return false;
+                            break;
+                        case '!':
+                            while (p < lineEnd && *p != ' ' && *p != '\t') ++p;
+                            continue;
+                        case '"':
+                        case '\'':
+                            quote = c;
+                            tokenColumn = p - lineBegin;
+                            tokenStart = false;
+                            ++p;
+                            continue;
+                        case '|':
+                        case '>':
+                            if (flowDepth > 0) return false;
+                            blockParent = static_cast<long>(parent);
+                            return true;
+                        case '-':
+                            if (flowDepth == 0 && IsSpace(p + 1, lineEnd)) {
+                                parent = p - lineBegin;
+                                ++p;
+                                continue;
+                            }
+                            break;
+                        case '[':
+                        case '{':
+                            ++flowDepth;
+                            ++p;
+                            continue;
+                        }
+                    }
+                    bool flowEnd = flowDepth > 0 && p + 1 < lineEnd && std::strchr(",[]{}", p[1]);
+                    if (c == ':' && (IsSpace(p + 1, lineEnd) || flowEnd)) {
+                        // the end of a key
+                        if (flowDepth == 0) parent = tokenColumn;
+                        tokenStart = true;
+                        plain = false;
+                        ++p;
+                        continue;
+                    }
+                    if (tokenStart && !plain) {
+                        tokenColumn = p - lineBegin;
+                        plain = true;
+                    }
+                    tokenStart = false;
+                    ++p;
+                }
+                return true;
+            }
+
+            const char* data;
+            const char* end;
+            const char* lineBegin = nullptr;
+            char quote = 0;        // the quote of a scalar that goes on to the next line
+            int flowDepth = 0;     // open flow collections
+            long blockParent = -1; // column of the node a block scalar belongs to, while in one
+        };
+
+        // Passes on the events within a YAML entry, dropping the map around it and, unless
+        // withKey, the events of its key. Positions are moved from the entry to the document.
+        class EntryEvents : public YAML::EventHandler {
+        public:
+            EntryEvents(YAML::EventHandler& handler, bool withKey, size_t offset) : handler(handler), inKey(!withKey), offset(offset) {}
+
+            void OnDocumentStart(const YAML::Mark&) override {}
+            void OnDocumentEnd() override {}
+            void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                if (Pass()) handler.OnNull(Shift(mark), anchor);
+                Complete();
+            }
+            void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override {
+                if (Pass()) handler.OnAlias(Shift(mark), anchor);
+                Complete();
+            }
+            void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override {
+                if (Pass()) handler.OnScalar(Shift(mark), tag, anchor, value);
+                Complete();
+            }
+            void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                if (Pass()) handler.OnSequenceStart(Shift(mark), tag, anchor, style);
+                ++depth;
+            }
+            void OnSequenceEnd() override {
+                --depth;
+                if (Pass()) handler.OnSequenceEnd();
+                Complete();
+            }
+            void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override {
+                if (depth > 0 && Pass()) handler.OnMapStart(Shift(mark), tag, anchor, style);
+                ++depth;
+            }
+            void OnMapEnd() override {
+                --depth;
+                if (depth > 0 && Pass()) handler.OnMapEnd();
+                Complete();
+            }
+
+        private:
+            bool Pass() const { return !inKey; }
+
+            YAML::Mark Shift(YAML::Mark mark) const {
+                mark.pos += static_cast<int>(offset);
+                return mark;
+            }
+
+            // A node within the entry map is complete, the first one is the key
+            void Complete() {
+                if (depth == 1) inKey = false;
+            }
+
+            YAML::EventHandler& handler;
+            bool inKey;
+            int depth = 0; // the entry map is depth 1
+            size_t offset; // of the entry in the document
+        };
+
+        void ParseYaml(const char* data, const Entry& entry, YAML::EventHandler& handler, bool withKey) {
+            EntryEvents events(handler, withKey, entry.begin);
+            MemoryStreamBuf buffer(data + entry.begin, entry.end - entry.begin);
+            std::istream stream(&buffer);
+            YAML::Parser parser(stream);
+            parser.HandleNextDocument(events);
+        }
+    }
+
+    bool Build(const char* data, size_t size, Index& index) {
+        index = Index();
+        index.json = json::IsJson(data, size);
+        bool built = index.json ? JsonScanner(data, size).Build(index) : YamlScanner(data, size).Build(index);
+        if (!built) index = Index();
+        return built;
+    }
+
+    void ParseEntry(const char* data, const Index& index, const Entry& entry, YAML::EventHandler& handler) {
+        if (index.json) {
+            json::ParseValue(data + entry.begin, entry.keyEnd - entry.begin, handler, entry.begin);
+            json::ParseValue(data + entry.value, entry.end - entry.value, handler, entry.value);
+            return;
+        }
+        ParseYaml(data, entry, handler, true);
+    }
+
+    void ParseValue(const char* data, const Index& index, const Entry& entry, YAML::EventHandler& handler) {
+        if (index.json) {
+            json::ParseValue(data + entry.value, entry.end - entry.value, handler, entry.value);
+            return;
+        }
+        ParseYaml(data, entry, handler, false);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "yaml-cpp/eventhandler.h"
+
+// Byte offsets of the top-level entries of a spec and of the entries of its paths map, found by
+// a scan over the raw input that builds no nodes. Each entry can then be parsed on its own,
+// when and if it is needed.
+namespace structural {
+
+    struct Entry {
+        std::string key;
+        size_t begin = 0;  // the key, for YAML the start of its line
+        size_t keyEnd = 0; // JSON only, a YAML entry is parsed as a whole
+        size_t value = 0;  // JSON only
+        size_t end = 0;
+    };
+
+    struct Index {
+        bool json = false;
+        std::vector<Entry> entries;    // of the root map, in document order
+        std::vector<Entry> paths;      // of the paths map
+        std::vector<Entry> components; // of the components map, empty when it is not split up
+    };
+
+    // False when the layout does not allow cutting the document into entries: the root or paths
+    // is not a non-empty map, the YAML uses anchors, aliases, directives or complex keys, a key
+    // is repeated, ... Such a document has to be parsed as a whole.
+    bool Build(const char* data, size_t size, Index& index);
+
+    // Reports the key and value of one entry as the events of YAML::Parser, without the
+    // document and map events around them. Mark positions count from the start of data.
+    // Throws YAML::ParserException.
+    void ParseEntry(const char* data, const Index& index, const Entry& entry, YAML::EventHandler& handler);
+    // The same for the value alone
+    void ParseValue(const char* data, const Index& index, const Entry& entry, YAML::EventHandler& handler);
+}
@@ -1,8 +1,23 @@
 #include "Util.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <mutex>
 #include <regex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 namespace util {
 
@@ -46,28 +61,91 @@ namespace util {
         return keys;
     }
 
-    YAML::Node Navigate(YAML::Node& base, const std::vector<std::string>& keys) {
-        YAML::Node cur = base;
+    std::string EncodeKey(const std::string& key) {
+        if (key.find_first_of("~/") == std::string::npos) return key;
+        std::string encoded;
+        for (char c : key) {
+            if (c == '~') encoded += "~0";
+            else if (c == '/') encoded += "~1";
+            else encoded += c;
+        }
+        return encoded;
+    }
+
+    static NodeView ChildView(const NodeView& parent, const std::string& key) {
+        if (parent.IsSequence() && !key.empty() && key.find_first_not_of("0123456789") == std::string::npos) {
+            return parent[static_cast<size_t>(std::stoul(key))];
+        }
+        return parent.IsMap() ? parent[key] : NodeView();
+    }
+
+    YAML::Node Child(const YAML::Node& parent, const std::string& key) {
+        return ChildView(parent, key).Bind(parent);
+    }
+
+    // Views only, so shared documents are never written to. A key missing from a map would
+    // otherwise be added to it, and assigning to a bound node rebinds the node it refers to.
+    YAML::Node Navigate(const YAML::Node& base, const std::vector<std::string>& keys) {
+        NodeView cur = base;
         for (const auto& key : keys) {
-            if (cur[key]) {
-                cur = cur[key];
-            }
-            else {
+            NodeView next = ChildView(cur, key);
+            if (!next) {
                 std::cerr << "Key not found: " << key << std::endl;
                 return YAML::Node();
             }
+            cur = next;
+        }
+        return cur.Bind(base);
+    }
+
+    YAML::Node Find(const YAML::Node& map, const std::string& key) {
+        return NodeView(map)[key].Bind(map);
+    }
+
+    const std::string& Text(const NodeView& node) {
+        static const std::string null = "null";
+        if (node.IsScalar()) return node.Scalar();
+        if (node.IsNull()) return null;
+        throw YAML::TypedBadConversion<std::string>(node.Mark());
+    }
+
+    YAML::Node NewNode(const YAML::Node& owner, YAML::NodeType::value type) {
+        if (!owner.IsValid() || !owner.GetMemory()) return YAML::Node(type);
+        YAML::detail::node& node = owner.GetMemory()->create_node();
+        node.set_type(type);
+        return YAML::Node(node, owner.GetMemory());
+    }
+
+    YAML::Node NewNode(const YAML::Node& owner, const std::string& scalar) {
+        if (!owner.IsValid() || !owner.GetMemory()) return YAML::Node(scalar);
+        YAML::detail::node& node = owner.GetMemory()->create_node();
+        node.set_scalar(scalar);
+        return YAML::Node(node, owner.GetMemory());
+    }
+
+    void RemoveKeys(YAML::Node& map, const std::vector<std::string>& keys) {
+        if (keys.size() == 1) {
+            map.remove(keys[0]);
+            return;
+        }
+        std::unordered_set<std::string> remove(keys.begin(), keys.end());
+        std::vector<YAML::Node> keyNodes;
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            if (remove.count(it->first.Scalar())) keyNodes.push_back(it->first);
+        }
+        for (const auto& key : keyNodes) {
+            map.remove(key);
         }
-        return cur;
     }
 
     bool IsJsonMimeType(const std::string& type) {
         return std::regex_match(type, r_application_json);
     }
 
-    std::vector<std::string> GetSupportedMimeTypes(const YAML::Node& content) {
+    std::vector<std::string> GetSupportedMimeTypes(const NodeView& content) {
         std::vector<std::string> supported;
         for (const auto& it : content) {
-            std::string key = it.first.as<std::string>();
+            const std::string& key = it.first.Scalar();
             if (key == "application/x-www-form-urlencoded" || key == "multipart/form-data" || IsJsonMimeType(key)) {
                 supported.push_back(key);
             }
@@ -75,10 +153,10 @@ namespace util {
         return supported;
     }
 
-    std::vector<std::string> GetMediaRanges(const YAML::Node& content) {
+    std::vector<std::string> GetMediaRanges(const NodeView& content) {
         std::vector<std::string> mediaRanges;
         for (const auto& it : content) {
-            std::string mediaRange = it.first.as<std::string>();
+            const std::string& mediaRange = it.first.Scalar();
             if (mediaRange.find('/') != std::string::npos) {
                 mediaRanges.push_back(mediaRange);
             }
@@ -95,28 +173,168 @@ namespace util {
         }
         return mediaTypes;
     }
+    // Same as replacing every "#/components/schemas/" and then every "#/components/" with regexes,
+    // without compiling two of them per call
     std::string FixRef(const std::string& ref) {
+        static const std::string components = "#/components/", xComponents = "#/x-components/";
+        static const std::string schemas = "#/components/schemas/", definitions = "#/definitions/";
+        if (ref.find(components) == std::string::npos) return ref;
+
         std::string fixedRef = ref;
-        fixedRef = std::regex_replace(fixedRef, std::regex(R"(#\/components\/schemas\/)"), "#/definitions/");
-        fixedRef = std::regex_replace(fixedRef, std::regex(R"(#\/components\/)"), "#/x-components/");
+        size_t pos = 0;
+        while ((pos = fixedRef.find(schemas, pos)) != std::string::npos) {
+            fixedRef.replace(pos, schemas.size(), definitions);
+            pos += definitions.size();
+        }
+        pos = 0;
+        while ((pos = fixedRef.find(components, pos)) != std::string::npos) {
+            fixedRef.replace(pos, components.size(), xComponents);
+            pos += xComponents.size();
+        }
         return fixedRef;
     }
-    void FixRefs(YAML::Node& obj) {
-        if (obj.IsSequence()) {
-            for (auto item : obj) {
-                FixRefs(item);
+    // Depth first over views with a work stack on the heap, so nesting is bounded by maxDepth and
+    // not by the stack size of the calling thread. Only the $ref values it rewrites are bound.
+    void FixRefs(YAML::Node& obj, size_t maxDepth) {
+        std::vector<std::pair<NodeView, size_t>> stack;
+        stack.emplace_back(obj, 1);
+        while (!stack.empty()) {
+            NodeView node = stack.back().first;
+            size_t depth = stack.back().second;
+            stack.pop_back();
+            if (depth > maxDepth) {
+                throw std::runtime_error("Document is nested more than " + std::to_string(maxDepth) + " levels deep");
+            }
+            if (node.IsSequence()) {
+                for (const auto& item : node) {
+                    if (item.IsMap() || item.IsSequence()) stack.emplace_back(item, depth + 1);
+                }
+            }
+            else if (node.IsMap()) {
+                for (const auto& entry : node) {
+                    if (entry.first.Scalar() == "$ref") {
+                        YAML::Node value = entry.second.Bind(obj);
+                        value = FixRef(value.as<std::string>());
+                    }
+                    else if (entry.second.IsMap() || entry.second.IsSequence()) {
+                        stack.emplace_back(entry.second, depth + 1);
+                    }
+                }
             }
         }
-        else if (obj.IsMap()) {
-            for (auto it = obj.begin(); it != obj.end(); ++it) {
-                std::string key = it->first.as<std::string>();
-                if (key == "$ref") {
-                    obj["$ref"] = FixRef(it->second.as<std::string>());
+    }
+
+    void FixRefsEvents::OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) {
+        // as<std::string>() reads null as "null"
+        if (refValue) handler.OnScalar(mark, "", anchor, FixRef("null"));
+        else handler.OnNull(mark, anchor);
+        Complete(false);
+    }
+
+    void FixRefsEvents::OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) {
+        handler.OnAlias(mark, anchor);
+        Complete(false);
+    }
+
+    void FixRefsEvents::OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) {
+        bool refKey = keyDepth == 0 && !frames.empty() && frames.back().map && frames.back().key && value == "$ref";
+        // assigning the string drops the tag, as in FixRefs
+        if (refValue) handler.OnScalar(mark, "", anchor, FixRef(value));
+        else handler.OnScalar(mark, tag, anchor, value);
+        Complete(refKey);
+    }
+
+    void FixRefsEvents::OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) {
+        Open(mark, false);
+        handler.OnSequenceStart(mark, tag, anchor, style);
+    }
+
+    void FixRefsEvents::OnSequenceEnd() {
+        handler.OnSequenceEnd();
+        Close();
+    }
+
+    void FixRefsEvents::OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) {
+        Open(mark, true);
+        handler.OnMapStart(mark, tag, anchor, style);
+    }
+
+    void FixRefsEvents::OnMapEnd() {
+        handler.OnMapEnd();
+        Close();
+    }
+
+    void FixRefsEvents::Open(const YAML::Mark& mark, bool map) {
+        if (refValue) throw YAML::TypedBadConversion<std::string>(mark);
+        if (keyDepth > 0 || (!frames.empty() && frames.back().map && frames.back().key)) ++keyDepth;
+        if (keyDepth == 0 && frames.size() + 1 > maxDepth) {
+            throw std::runtime_error("Document is nested more than " + std::to_string(maxDepth) + " levels deep");
+        }
+        frames.push_back(Frame{ map, true });
+    }
+
+    void FixRefsEvents::Close() {
+        frames.pop_back();
+        if (keyDepth > 0) --keyDepth;
+        Complete(false);
+    }
+
+    // A node is complete, a key is followed by its value and a value by the next key
+    void FixRefsEvents::Complete(bool refKey) {
+        refValue = false;
+        if (keyDepth > 0 || frames.empty() || !frames.back().map) return;
+        Frame& frame = frames.back();
+        refValue = frame.key && refKey;
+        frame.key = !frame.key;
+    }
+
+    size_t PeakMemoryUsage() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    void ParallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& task) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+
+        std::atomic<size_t> next{ 0 };
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto work = [&]() {
+            size_t i;
+            while ((i = next++) < count) {
+                try {
+                    task(i);
                 }
-                else {
-                    FixRefs(it->second);
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    next = count;
                 }
             }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
         }
+        if (error) std::rethrow_exception(error);
     }
-}
\ No newline at end of file
+}
@@ -1,5 +1,9 @@
 #pragma once
+#include <functional>
 #include <string>
+#include <vector>
+#include "NodeView.h"
+#include "yaml-cpp/eventhandler.h"
 #include "yaml-cpp/yaml.h"
 namespace util {
 
@@ -11,17 +15,83 @@ namespace util {
 
     URL ParseURL(const std::string& url);
 
-    YAML::Node Navigate(YAML::Node& base, const std::vector<std::string>& keys);
+    // The entry of a map, or item of a sequence for a numeric key, for one JSON pointer key.
+    // Never adds the key, a missing one gives an undefined node.
+    YAML::Node Child(const YAML::Node& parent, const std::string& key);
+
+    YAML::Node Navigate(const YAML::Node& base, const std::vector<std::string>& keys);
+
+    // The value of key in a map without adding the key: missing, it is the invalid node the const
+    // operator[] gives, and looking into that again gives it once more. Unlike operator[], keys
+    // are compared in place instead of decoding a copy of each, and nothing is allocated. Throws
+    // YAML::BadSubscript on a scalar, like operator[].
+    YAML::Node Find(const YAML::Node& map, const std::string& key);
+    // What `if (map[key])` tests, the key is there, even with a null value
+    inline bool Has(const NodeView& map, const std::string& key) { return static_cast<bool>(map[key]); }
+    // A new node in the memory of owner's document, or of its own when owner has none yet. Linking
+    // in a node of another memory merges the two, which is cheap but not free: YAML::Node(type)
+    // allocates a memory and a block for its one node. A node made here needs neither.
+    YAML::Node NewNode(const YAML::Node& owner, YAML::NodeType::value type);
+    YAML::Node NewNode(const YAML::Node& owner, const std::string& scalar);
+
+    // The string as<std::string>() reads from a scalar, "null" for a null node, without copying
+    // it. Throws YAML::TypedBadConversion<std::string> for anything else.
+    const std::string& Text(const NodeView& node);
+
+    // Removes several keys of a map in one pass. yaml-cpp's remove(key) scans the entries and
+    // copies each key it compares; removing by key node only compares node identities.
+    void RemoveKeys(YAML::Node& map, const std::vector<std::string>& keys);
 
     std::vector<std::string> SplitAndDecode(const std::string& ref);
+    // The reverse of SplitAndDecode for one key, "a/b" becomes "a~1b"
+    std::string EncodeKey(const std::string& key);
 
     bool IsJsonMimeType(const std::string& type);
 
-    std::vector<std::string> GetSupportedMimeTypes(const YAML::Node& content);
+    std::vector<std::string> GetSupportedMimeTypes(const NodeView& content);
 
-    std::vector<std::string> GetMediaRanges(const YAML::Node& content);
+    std::vector<std::string> GetMediaRanges(const NodeView& content);
 
     std::vector<std::string> GetMediaTypes(const std::vector<std::string>& mediaRanges);
 
-    void FixRefs(YAML::Node& obj);
+    std::string FixRef(const std::string& ref);
+    void FixRefs(YAML::Node& obj, size_t maxDepth = 2000);
+
+    // FixRefs for a subtree that is never built: passes the events on to handler with the value
+    // of every $ref rewritten, and throws where FixRefs would
+    class FixRefsEvents : public YAML::EventHandler {
+    public:
+        FixRefsEvents(YAML::EventHandler& handler, size_t maxDepth = 2000) : handler(handler), maxDepth(maxDepth) {}
+
+        void OnDocumentStart(const YAML::Mark& mark) override { handler.OnDocumentStart(mark); }
+        void OnDocumentEnd() override { handler.OnDocumentEnd(); }
+        void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override;
+        void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override;
+        void OnScalar(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, const std::string& value) override;
+        void OnSequenceStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override;
+        void OnSequenceEnd() override;
+        void OnMapStart(const YAML::Mark& mark, const std::string& tag, YAML::anchor_t anchor, YAML::EmitterStyle::value style) override;
+        void OnMapEnd() override;
+
+    private:
+        void Open(const YAML::Mark& mark, bool map);
+        void Close();
+        void Complete(bool refKey);
+
+        struct Frame {
+            bool map;
+            bool key; // the next node of the map is a key
+        };
+        YAML::EventHandler& handler;
+        size_t maxDepth;
+        std::vector<Frame> frames;
+        size_t keyDepth = 0;   // containers open within a key, FixRefs does not look into keys
+        bool refValue = false; // the next node is the value of a $ref
+    };
+
+    size_t PeakMemoryUsage();
+
+    // Runs task(0) .. task(count - 1) on up to threads workers (0 for one per core), each taking the
+    // next index as it becomes free. The first exception thrown by a task is rethrown.
+    void ParallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& task);
 }
\ No newline at end of file
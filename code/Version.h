@@ -0,0 +1,4 @@
+#pragma once
+
+// Bump whenever the conversion output changes, cached results are keyed on it
+#define OPENAPI_DOWNGRADER_VERSION "1.4.0"
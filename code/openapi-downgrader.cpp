@@ -1,18 +1,268 @@
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <vector>
+#include "Batch.h"
+#include "Cache.h"
 #include "Converter.h"
+#include "Documents.h"
+#include "MappedFile.h"
+#include "OutputFile.h"
+#include "Server.h"
+#include "Util.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+void setBinaryMode(FILE* file) {
+#ifdef _WIN32
+    _setmode(_fileno(file), _O_BINARY);
+#else
+    (void)file;
+#endif
+}
+
+void printProfile(const ConversionProfile& profile) {
+    std::cerr << "load: " << profile.loadMs << " ms, convert: " << profile.convertMs << " ms, emit: " << profile.emitMs
+        << " ms, peak RSS: " << util::PeakMemoryUsage() / (1024 * 1024) << " MB" << std::endl;
+    std::cerr << "$ref index: " << profile.refHits << " hits, " << profile.refMisses << " misses" << std::endl;
+}
+
+bool parseOutputFormat(const std::string& value, OutputFormat& format) {
+    if (value == "yaml") {
+        format = OutputFormat::Yaml;
+        return true;
+    }
+    if (value == "json") {
+        format = OutputFormat::Json;
+        return true;
+    }
+    return false;
+}
 
 void printHelp() {
-    std::cout << "Usage: openapi-downgrader filename_in filename_out\n";
+    std::cout << "Usage: openapi-downgrader filename_in filename_out [--profile] [--no-mmap] [--cache <dir|url>] [--output-format yaml|json]\n";
+    std::cout << "                          [--jobs N] [--threads N] [--max-depth N] [--split-documents] [--compact] [--stream]  (\"-\" reads stdin / writes stdout)\n";
+    std::cout << "       openapi-downgrader --batch <directory|manifest> [output_directory] [--jobs N] [--max-memory MB] [--cache <dir|url>] [--output-format yaml|json|auto] [--compact] [--stream]\n";
+    std::cout << "       openapi-downgrader serve --socket <path> [--workers N] [--max-request-size MB]\n";
+    std::cout << "       openapi-downgrader client --socket <path> (--stats | filename_in [filename_out] [--repeat N] [--memfd])\n";
+}
+
+// "out.yaml" becomes "out.1.yaml", "out.2.yaml", ...
+std::string documentPath(const std::string& path, size_t index) {
+    std::filesystem::path p(path);
+    std::string name = p.stem().string() + "." + std::to_string(index + 1) + p.extension().string();
+    return (p.parent_path() / name).string();
+}
+
+// A multi-document stream is converted one document per worker, into one stream or one file each
+int runDocuments(const char* data, const std::vector<documents::Range>& ranges, const documents::Options& options,
+    const std::string& filename_out, bool split, bool profile) {
+    auto start = std::chrono::steady_clock::now();
+    bool toStdout = filename_out == "-";
+    if (split && toStdout) {
+        std::cerr << "--split-documents needs an output filename" << std::endl;
+        return 1;
+    }
+    if (toStdout) {
+        setBinaryMode(stdout);
+    }
+
+    std::unique_ptr<OutputFile> stream;
+    if (!split && !toStdout) {
+        stream = std::make_unique<OutputFile>(filename_out);
+        if (!stream->IsOpen()) {
+            std::cerr << "Failed to open output file: " << filename_out << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = stream ? stream->Stream() : std::cout;
+
+    try {
+        documents::ConvertAll(data, ranges, options, [&](size_t index, const std::string& output) {
+            if (split) {
+                std::string path = documentPath(filename_out, index);
+                OutputFile file(path);
+                if (!file.IsOpen()) {
+                    throw std::runtime_error("Failed to open output file: " + path);
+                }
+                file.Stream() << output;
+                if (!file.Commit()) {
+                    throw std::runtime_error("Failed to write output file: " + path);
+                }
+                return;
+            }
+            // JSON has no document separator, the documents become the items of one array
+            if (options.converter.format == OutputFormat::Json) {
+                out << (index == 0 ? "[\n" : ",\n");
+                size_t length = output.size();
+                if (length > 0 && output[length - 1] == '\n') --length;
+                out.write(output.data(), static_cast<std::streamsize>(length));
+                return;
+            }
+            // the YAML emitter leaves the last line open
+            if (index > 0) {
+                out << "\n---\n";
+            }
+            out << output;
+        });
+        if (!split && options.converter.format == OutputFormat::Json) {
+            out << "\n]\n";
+        }
+    }
+    catch (const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        return 1;
+    }
+
+    if (stream && !stream->Commit()) {
+        std::cerr << "Failed to write output file: " << filename_out << std::endl;
+        return 1;
+    }
+    if (toStdout) {
+        if (!std::cout) return 1;
+    }
+    else {
+        std::cout << "\nConverted " << ranges.size() << " documents. Output written to "
+            << (split ? documentPath(filename_out, 0) + " .. " + documentPath(filename_out, ranges.size() - 1) : filename_out) << std::endl;
+    }
+
+    if (profile) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << ranges.size() << " documents in " << ms << " ms, peak RSS: " << util::PeakMemoryUsage() / (1024 * 1024) << " MB" << std::endl;
+    }
+    return 0;
+}
+
+int runBatch(int argc, char* argv[]) {
+    std::string target = argv[2];
+    batch::Options options;
+
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            options.jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-memory" && i + 1 < argc) {
+            options.maxMemory = static_cast<size_t>(std::stoull(argv[++i])) * 1024 * 1024;
+        }
+        else if (arg == "--cache" && i + 1 < argc) {
+            options.cache = argv[++i];
+        }
+        else if (arg == "--compact") {
+            options.compact = true;
+        }
+        else if (arg == "--stream") {
+            options.streaming = true;
+        }
+        else if (arg == "--output-format" && i + 1 < argc) {
+            options.outputFormat = argv[++i];
+            OutputFormat format;
+            if (options.outputFormat != "auto" && !parseOutputFormat(options.outputFormat, format)) {
+                printHelp();
+                return 1;
+            }
+        }
+        else if (options.outputDir.empty() && arg.rfind("--", 0) != 0) {
+            options.outputDir = arg;
+        }
+        else {
+            printHelp();
+            return 1;
+        }
+    }
+
+    return batch::Run(target, options);
+}
+
+int runServe(int argc, char* argv[]) {
+    server::Options options;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            options.socket = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-request-size" && i + 1 < argc) {
+            options.maxRequestSize = static_cast<uint64_t>(std::stoull(argv[++i])) * 1024 * 1024;
+        }
+        else {
+            printHelp();
+            return 1;
+        }
+    }
+    if (options.socket.empty()) {
+        printHelp();
+        return 1;
+    }
+
+    return server::Serve(options);
+}
+
+int runClient(int argc, char* argv[]) {
+    server::ClientOptions options;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            options.socket = argv[++i];
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+        }
+        else if (arg == "--memfd") {
+            options.memfd = true;
+        }
+        else if (arg == "--stats") {
+            options.stats = true;
+        }
+        else if (options.input.empty()) {
+            options.input = arg;
+        }
+        else if (options.output.empty()) {
+            options.output = arg;
+        }
+        else {
+            printHelp();
+            return 1;
+        }
+    }
+    if (options.socket.empty() || (options.input.empty() && !options.stats)) {
+        printHelp();
+        return 1;
+    }
+
+    return server::RunClient(options);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    if (argc < 3) {
         printHelp();
         return 1;
     }
 
+    std::string command = argv[1];
+    if (command == "--batch") {
+        return runBatch(argc, argv);
+    }
+    if (command == "serve") {
+        return runServe(argc, argv);
+    }
+    if (command == "client") {
+        return runClient(argc, argv);
+    }
+
     std::string filename_in = argv[1];
     std::string filename_out = argv[2];
 
@@ -21,19 +271,138 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    Converter converter;
-    auto result = converter.Convert(filename_in);
+    ConverterOptions options;
+    bool profile = false;
+    bool splitDocuments = false;
+    unsigned jobs = 0;
+    std::string cacheLocation;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--profile") {
+            profile = true;
+        }
+        else if (arg == "--no-mmap") {
+            options.mapInput = false;
+        }
+        else if (arg == "--cache" && i + 1 < argc) {
+            cacheLocation = argv[++i];
+        }
+        else if (arg == "--output-format" && i + 1 < argc && parseOutputFormat(argv[i + 1], options.format)) {
+            ++i;
+        }
+        else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-depth" && i + 1 < argc) {
+            options.maxDepth = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--split-documents") {
+            splitDocuments = true;
+        }
+        else if (arg == "--compact") {
+            options.compact = true;
+        }
+        else if (arg == "--stream") {
+            options.streaming = true;
+        }
+        else {
+            printHelp();
+            return 1;
+        }
+    }
+
+    std::unique_ptr<Cache> cache;
+    if (!cacheLocation.empty()) {
+        try {
+            cache = Cache::Open(cacheLocation);
+        }
+        catch (const std::exception& err) {
+            std::cerr << "Failed to open cache " << cacheLocation << ": " << err.what() << std::endl;
+            return 1;
+        }
+    }
 
-    std::ofstream outFile(filename_out);
-    if (outFile.is_open()) {
-        outFile << result;
-        outFile.close();
-        std::cout << "\nConversion successful. Output written to " << filename_out << std::endl;
+    // The input is read up front to find out how many documents it holds
+    MappedFile mapped;
+    std::string buffer;
+    const char* data = nullptr;
+    size_t size = 0;
+    if (filename_in == "-") {
+        setBinaryMode(stdin);
+        buffer.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+    else if (options.mapInput && mapped.Open(filename_in)) {
+        data = mapped.Data();
+        size = mapped.Size();
     }
     else {
-        std::cerr << "Failed to open output file: " << filename_out << std::endl;
-        return 1;
+        std::ifstream in(filename_in, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Failed to open input file: " << filename_in << std::endl;
+            return 1;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    if (!data) {
+        data = buffer.data();
+        size = buffer.size();
+    }
+
+    auto documents = documents::Split(data, size);
+    if (documents.size() > 1) {
+        documents::Options documentOptions;
+        documentOptions.converter = options;
+        documentOptions.jobs = jobs;
+        documentOptions.cache = cache.get();
+        return runDocuments(data, documents, documentOptions, filename_out, splitDocuments, profile);
+    }
+
+    Converter converter(options);
+    auto convert = [&](std::ostream& out) {
+        try {
+            if (cache) {
+                cache->Convert(converter, data, size, out);
+            }
+            else {
+                converter.Convert(data, size, out);
+            }
+            return true;
+        }
+        catch (const std::exception& err) {
+            std::cerr << "Conversion failed: " << err.what() << std::endl;
+            return false;
+        }
+    };
+
+    if (filename_out == "-") {
+        setBinaryMode(stdout);
+        if (!convert(std::cout) || !std::cout) return 1;
+    }
+    else {
+        OutputFile outFile(filename_out);
+        if (!outFile.IsOpen()) {
+            std::cerr << "Failed to open output file: " << filename_out << std::endl;
+            return 1;
+        }
+        if (!convert(outFile.Stream())) return 1;
+        if (!outFile.Commit()) {
+            std::cerr << "Failed to write output file: " << filename_out << std::endl;
+            return 1;
+        }
+        if (outFile.Unchanged()) {
+            std::cout << "\nOutput is unchanged, " << filename_out << " was left untouched" << std::endl;
+        }
+        else {
+            std::cout << "\nConversion successful. Output written to " << filename_out << std::endl;
+        }
+    }
+
+    if (profile) {
+        printProfile(converter.GetProfile());
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -124,18 +124,19 @@ inline node* node_data::get(const Key& key,
     case NodeType::Null:
       return nullptr;
     case NodeType::Sequence:
-      if (node* pNode = get_idx<Key>::get(m_sequence, key, pMemory))
+      if (node* pNode = get_idx<Key>::get(items().sequence, key, pMemory))
         return pNode;
       return nullptr;
     case NodeType::Scalar:
       throw BadSubscript(m_mark, key);
   }
 
-  auto it = std::find_if(m_map.begin(), m_map.end(), [&](const kv_pair m) {
+  const node_map& map = items().map;
+  auto it = std::find_if(map.begin(), map.end(), [&](const kv_pair m) {
     return m.first->equals(key, pMemory);
   });
 
-  return it != m_map.end() ? it->second : nullptr;
+  return it != map.end() ? it->second : nullptr;
 }
 
 template <typename Key>
@@ -146,7 +147,7 @@ inline node& node_data::get(const Key& key, shared_memory_holder pMemory) {
     case NodeType::Undefined:
     case NodeType::Null:
     case NodeType::Sequence:
-      if (node* pNode = get_idx<Key>::get(m_sequence, key, pMemory)) {
+      if (node* pNode = get_idx<Key>::get(own_items().sequence, key, pMemory)) {
         m_type = NodeType::Sequence;
         return *pNode;
       }
@@ -157,11 +158,12 @@ inline node& node_data::get(const Key& key, shared_memory_holder pMemory) {
       throw BadSubscript(m_mark, key);
   }
 
-  auto it = std::find_if(m_map.begin(), m_map.end(), [&](const kv_pair m) {
+  node_map& map = own_items().map;
+  auto it = std::find_if(map.begin(), map.end(), [&](const kv_pair m) {
     return m.first->equals(key, pMemory);
   });
 
-  if (it != m_map.end()) {
+  if (it != map.end()) {
     return *it->second;
   }
 
@@ -174,25 +176,27 @@ inline node& node_data::get(const Key& key, shared_memory_holder pMemory) {
 template <typename Key>
 inline bool node_data::remove(const Key& key, shared_memory_holder pMemory) {
   if (m_type == NodeType::Sequence) {
-    return remove_idx<Key>::remove(m_sequence, key, m_seqSize);
+    collection& items = own_items();
+    return remove_idx<Key>::remove(items.sequence, key, items.seqSize);
   }
 
   if (m_type == NodeType::Map) {
-    kv_pairs::iterator it = m_undefinedPairs.begin();
-    while (it != m_undefinedPairs.end()) {
+    collection& items = own_items();
+    kv_pairs::iterator it = items.undefinedPairs.begin();
+    while (it != items.undefinedPairs.end()) {
       kv_pairs::iterator jt = std::next(it);
       if (it->first->equals(key, pMemory)) {
-        m_undefinedPairs.erase(it);
+        items.undefinedPairs.erase(it);
       }
       it = jt;
     }
 
-    auto iter = std::find_if(m_map.begin(), m_map.end(), [&](const kv_pair m) {
+    auto iter = std::find_if(items.map.begin(), items.map.end(), [&](const kv_pair m) {
       return m.first->equals(key, pMemory);
     });
 
-    if (iter != m_map.end()) {
-      m_map.erase(iter);
+    if (iter != items.map.end()) {
+      items.map.erase(iter);
       return true;
     }
   }
@@ -7,7 +7,7 @@
 #pragma once
 #endif
 
-#include <set>
+#include <cstddef>
 
 #include "yaml-cpp/dll.h"
 #include "yaml-cpp/node/ptr.h"
@@ -20,25 +20,45 @@ class node;
 
 namespace YAML {
 namespace detail {
+// The nodes of one document. They are carved out of blocks that all go at once
+// with the memory, so creating a node is a bump of a counter. Merging links the
+// blocks of the smaller memory into the larger one and leaves the smaller one
+// forwarding to it, which costs the same for any number of nodes.
 class YAML_CPP_API memory {
  public:
-  memory() : m_nodes{} {}
+  memory() : m_blocks(nullptr), m_last(nullptr), m_size(0), m_forward{} {}
+  memory(const memory&) = delete;
+  memory& operator=(const memory&) = delete;
+  ~memory();
+
   node& create_node();
-  void merge(const memory& rhs);
+  void merge(memory& rhs);
+
+  std::size_t size() const { return m_size; }
 
  private:
-  using Nodes = std::set<shared_node>;
-  Nodes m_nodes;
+  friend class memory_holder;
+  struct block;
+
+  // nodes are created in the first block, the others are full or merged in
+  block* m_blocks;
+  block* m_last;
+  std::size_t m_size;
+
+  // the memory this one was merged into
+  shared_memory m_forward;
 };
 
 class YAML_CPP_API memory_holder {
  public:
   memory_holder() : m_pMemory(new memory) {}
 
-  node& create_node() { return m_pMemory->create_node(); }
+  node& create_node() { return current().create_node(); }
   void merge(memory_holder& rhs);
 
  private:
+  memory& current();
+
   shared_memory m_pMemory;
 };
 }  // namespace detail
@@ -24,7 +24,7 @@ class node {
   };
 
  public:
-  node() : m_pRef(new node_ref), m_dependencies{}, m_index{} {}
+  node() : m_pRef(std::make_shared<node_ref>()), m_pDependencies{}, m_index{} {}
   node(const node&) = delete;
   node& operator=(const node&) = delete;
 
@@ -48,16 +48,21 @@ class node {
       return;
 
     m_pRef->mark_defined();
-    for (node* dependency : m_dependencies)
-      dependency->mark_defined();
-    m_dependencies.clear();
+    if (m_pDependencies) {
+      for (node* dependency : *m_pDependencies)
+        dependency->mark_defined();
+      m_pDependencies.reset();
+    }
   }
 
   void add_dependency(node& rhs) {
     if (is_defined())
       rhs.mark_defined();
-    else
-      m_dependencies.insert(&rhs);
+    else {
+      if (!m_pDependencies)
+        m_pDependencies.reset(new nodes);
+      m_pDependencies->insert(&rhs);
+    }
   }
 
   void set_ref(const node& rhs) {
@@ -167,7 +172,8 @@ class node {
  private:
   shared_node_ref m_pRef;
   using nodes = std::set<node*, less>;
-  nodes m_dependencies;
+  // only a node that is not defined yet has any
+  std::unique_ptr<nodes> m_pDependencies;
   size_t m_index;
   static YAML_CPP_API std::atomic<size_t> m_amount;
 };
@@ -9,6 +9,7 @@
 
 #include <list>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -47,7 +48,7 @@ class YAML_CPP_API node_data {
     return m_isDefined ? m_type : NodeType::Undefined;
   }
   const std::string& scalar() const { return m_scalar; }
-  const std::string& tag() const { return m_tag; }
+  const std::string& tag() const { return *m_tag; }
   EmitterStyle::value style() const { return m_style; }
 
   // size/iterator
@@ -97,29 +98,47 @@ class YAML_CPP_API node_data {
   template <typename T>
   static node& convert_to_node(const T& rhs, shared_memory_holder pMemory);
 
+  static const std::string* intern_tag(const std::string& tag);
+
  private:
-  bool m_isDefined;
-  Mark m_mark;
-  NodeType::value m_type;
-  std::string m_tag;
-  EmitterStyle::value m_style;
+  using node_seq = std::vector<node *>;
+  using node_map = std::vector<std::pair<node*, node*>>;
+  using kv_pair = std::pair<node*, node*>;
+  using kv_pairs = std::list<kv_pair>;
 
-  // scalar
-  std::string m_scalar;
+  // What only a sequence or a map uses, made the first time the node becomes
+  // one. Most nodes of a document are scalars and go without.
+  struct collection {
+    node_seq sequence;
+    mutable std::size_t seqSize = 0;
+    node_map map;
+    mutable kv_pairs undefinedPairs;
+  };
+
+  const collection& items() const {
+    return m_pItems ? *m_pItems : no_items();
+  }
+  collection& own_items() {
+    if (!m_pItems)
+      m_pItems.reset(new collection);
+    return *m_pItems;
+  }
+  static const collection& no_items();
 
-  // sequence
-  using node_seq = std::vector<node *>;
-  node_seq m_sequence;
+  Mark m_mark;
+  // a byte each, so they and the flag fit in the word after the Mark
+  NodeType::value m_type : 8;
+  EmitterStyle::value m_style : 8;
+  bool m_isDefined;
 
-  mutable std::size_t m_seqSize;
+  // interned, a document has few different tags
+  const std::string* m_tag;
 
-  // map
-  using node_map = std::vector<std::pair<node*, node*>>;
-  node_map m_map;
+  // scalar
+  std::string m_scalar;
 
-  using kv_pair = std::pair<node*, node*>;
-  using kv_pairs = std::list<kv_pair>;
-  mutable kv_pairs m_undefinedPairs;
+  // sequence and map
+  std::unique_ptr<collection> m_pItems;
 };
 }
 }
@@ -113,11 +113,20 @@ class YAML_CPP_API Node {
   template <typename Key, typename Value>
   void force_insert(const Key& key, const Value& value);
 
+  // Not in upstream yaml-cpp, added with the vendored node layer: the node and
+  // memory behind this one, to walk a document without a Node per step and to
+  // create nodes in the memory of the document they will join.
+  bool IsValid() const { return m_isValid; }
+  // nullptr for a null node that was never changed
+  const detail::node* GetNode() const { return m_pNode; }
+  const detail::shared_memory_holder& GetMemory() const { return m_pMemory; }
+  // A node of the memory pMemory
+  explicit Node(detail::node& node, detail::shared_memory_holder pMemory);
+
  private:
   enum Zombie { ZombieNode };
   explicit Node(Zombie);
   explicit Node(Zombie, const std::string&);
-  explicit Node(detail::node& node, detail::shared_memory_holder pMemory);
 
   void EnsureNodeExists() const;
 
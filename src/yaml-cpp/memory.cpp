@@ -0,0 +1,112 @@
+#include "yaml-cpp/node/detail/memory.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include "yaml-cpp/node/detail/node.h"  // IWYU pragma: keep
+#include "yaml-cpp/node/ptr.h"
+
+namespace YAML {
+namespace detail {
+
+// The nodes follow the block in the same allocation
+struct alignas(node) memory::block {
+  block* next;
+  std::size_t used;
+  std::size_t capacity;
+
+  node* nodes() { return reinterpret_cast<node*>(this + 1); }
+};
+
+namespace {
+// A memory of one node is what every YAML::Node(...) temporary creates, so
+// blocks start small and grow with the memory
+const std::size_t max_block_nodes = 1024;
+}  // namespace
+
+memory::~memory() {
+  block* pBlock = m_blocks;
+  while (pBlock) {
+    block* next = pBlock->next;
+    node* nodes = pBlock->nodes();
+    for (std::size_t i = 0; i < pBlock->used; i++)
+      nodes[i].~node();
+    ::operator delete(pBlock);
+    pBlock = next;
+  }
+}
+
+node& memory::create_node() {
+  if (!m_blocks || m_blocks->used == m_blocks->capacity) {
+    std::size_t capacity =
+        std::min(max_block_nodes, std::max<std::size_t>(m_size, 1));
+    block* pBlock = static_cast<block*>(
+        ::operator new(sizeof(block) + capacity * sizeof(node)));
+    pBlock->next = m_blocks;
+    pBlock->used = 0;
+    pBlock->capacity = capacity;
+    m_blocks = pBlock;
+    if (!m_last)
+      m_last = pBlock;
+  }
+
+  node* pNode = new (m_blocks->nodes() + m_blocks->used) node;
+  m_blocks->used++;
+  m_size++;
+  return *pNode;
+}
+
+void memory::merge(memory& rhs) {
+  if (!rhs.m_blocks)
+    return;
+
+  // behind the first block, which stays the one nodes are created in
+  if (m_last)
+    m_last->next = rhs.m_blocks;
+  else
+    m_blocks = rhs.m_blocks;
+  m_last = rhs.m_last;
+  m_size += rhs.m_size;
+
+  rhs.m_blocks = nullptr;
+  rhs.m_last = nullptr;
+  rhs.m_size = 0;
+}
+
+memory& memory_holder::current() {
+  if (!m_pMemory->m_forward)
+    return *m_pMemory;
+
+  shared_memory pRoot = m_pMemory->m_forward;
+  while (pRoot->m_forward)
+    pRoot = pRoot->m_forward;
+
+  // every memory on the way forwards straight to the root from now on
+  shared_memory pMemory = m_pMemory;
+  while (pMemory != pRoot) {
+    shared_memory next = pMemory->m_forward;
+    pMemory->m_forward = pRoot;
+    pMemory = std::move(next);
+  }
+
+  m_pMemory = std::move(pRoot);
+  return *m_pMemory;
+}
+
+void memory_holder::merge(memory_holder& rhs) {
+  current();
+  rhs.current();
+  if (m_pMemory == rhs.m_pMemory)
+    return;
+
+  // the smaller one forwards, which keeps the chains of forwards short
+  if (m_pMemory->size() < rhs.m_pMemory->size())
+    std::swap(m_pMemory, rhs.m_pMemory);
+
+  m_pMemory->merge(*rhs.m_pMemory);
+  rhs.m_pMemory->m_forward = m_pMemory;
+  rhs.m_pMemory = m_pMemory;
+}
+}  // namespace detail
+}  // namespace YAML
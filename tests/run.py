@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Converts the specs in this directory, and a few generated ones, and checks the results.
+
+    python3 tests/run.py path/to/openapi-downgrader
+
+Each case names an input, the options to convert it with and what has to come out: a file equal
+to one next to this script, a YAML document whose anchors are each defined once and before their
+aliases, or an error.
+"""
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from collections import namedtuple
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+Output = namedtuple("Output", "reference")  # equal to the reference, and Anchors
+Anchors = namedtuple("Anchors", "")
+Fails = namedtuple("Fails", "message")      # exits with an error that contains message
+Inline = namedtuple("Inline", "name text")  # an input written out by the script
+
+
+def nested(depth, inner):
+    """A JSON spec with an extension of depth arrays nested around inner"""
+    text = ('{"openapi": "3.0.0", "info": {"title": "t", "version": "1"}, "paths": {}, "x-deep": '
+            + "[" * depth + inner + "]" * depth + "}")
+    return Inline(f"nested {depth} {inner!r}", text)
+
+
+CASES = [
+    # an anchor in paths aliased from components, and anchors within both
+    ("aliases.yaml", [], Output("aliases.out.yaml")),
+    ("aliases.yaml", ["--stream"], Anchors()),
+    ("aliases.yaml", ["--compact"], Anchors()),
+    ("aliases.yaml", ["--threads", "4"], Anchors()),
+    # YAML that starts like JSON goes to the YAML parser
+    (Inline("flow mapping", '{openapi: 3.0.0, info: {title: t, version: "1"}, paths: {}} # flow\n'), [], Anchors()),
+    # strict JSON is reported by the JSON parser; yaml-cpp gives up on the nesting and would
+    # report "bad file" instead
+    (nested(1990, "1"), [], Anchors()),
+    (nested(1990, "1 2"), [], Fails("expected ']'")),
+    (nested(1990, "1 2"), ["--stream"], Fails("expected ']'")),
+    (nested(2100, "1"), [], Fails("document is nested too deeply")),
+    (nested(2100, "1"), ["--compact"], Fails("document is nested too deeply")),
+]
+
+ANCHOR = re.compile(r"(?:^|[\s\[{,:-])([&*])(\w+)")
+
+
+def check_anchors(text):
+    defined = set()
+    for number, line in enumerate(text.splitlines(), 1):
+        for kind, name in ANCHOR.findall(line):
+            if kind == "&":
+                if name in defined:
+                    return f"line {number}: anchor &{name} defined again"
+                defined.add(name)
+            elif name not in defined:
+                return f"line {number}: alias *{name} before its anchor"
+    return None
+
+
+def run(binary, source, options, expected):
+    with tempfile.TemporaryDirectory() as scratch:
+        if isinstance(source, Inline):
+            path = os.path.join(scratch, "spec.json")
+            with open(path, "w", encoding="utf-8") as spec:
+                spec.write(source.text)
+        else:
+            path = os.path.join(HERE, source)
+        target = os.path.join(scratch, "out.yaml")
+        result = subprocess.run([binary, path, target] + options, capture_output=True, text=True)
+        if isinstance(expected, Fails):
+            if result.returncode == 0:
+                return "converted, expected an error"
+            if expected.message not in result.stderr:
+                return f"error without {expected.message!r}: {result.stderr.strip()}"
+            return None
+        if result.returncode != 0:
+            return f"exit code {result.returncode}: {result.stderr.strip()}"
+        with open(target, encoding="utf-8") as out:
+            text = out.read()
+    if isinstance(expected, Output):
+        with open(os.path.join(HERE, expected.reference), encoding="utf-8") as reference:
+            if text != reference.read():
+                return f"output differs from {expected.reference}"
+    return check_anchors(text)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: run.py <openapi-downgrader>")
+    failed = 0
+    for source, options, expected in CASES:
+        error = run(sys.argv[1], source, options, expected)
+        name = " ".join([source.name if isinstance(source, Inline) else source] + options)
+        print(f"{'FAIL' if error else 'ok'}  {name}" + (f": {error}" if error else ""))
+        failed += error is not None
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()